@@ -0,0 +1,70 @@
+#ifndef MVCC_LINEAR_HASHTABLE_COUNTER_H
+#define MVCC_LINEAR_HASHTABLE_COUNTER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+#include "epoch.h"
+
+// Striped counter
+// Each thread adds into its own cache line and only folds into the shared total once
+// its pending delta passes the caller's slack, so approx() drifts by at most
+// num_stripes * slack. slack == 0 goes straight to the total and is exact.
+namespace lh {
+
+class StripedCounter {
+public:
+    StripedCounter() = default;
+
+    StripedCounter(const StripedCounter&) = delete;
+    StripedCounter& operator=(const StripedCounter&) = delete;
+
+    void add(ptrdiff_t delta, size_t slack);
+
+    size_t approx() const;
+    size_t exact() const;  // total plus every stripe, exact once writers are quiescent
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<ptrdiff_t> pending{0};
+    };
+
+    static constexpr size_t num_stripes = 16;
+
+    alignas(64) std::atomic<ptrdiff_t> total{0};
+    std::array<Stripe, num_stripes> stripes;
+
+    static size_t clamp(ptrdiff_t count) { return count < 0 ? 0 : static_cast<size_t>(count); }
+};
+
+// IMPLEMENTATION===========================================
+inline void StripedCounter::add(ptrdiff_t delta, size_t slack) {
+    if (slack == 0) {
+        total.fetch_add(delta);
+        return;
+    }
+
+    // same per thread index the reclaimer stripes on
+    auto& stripe = stripes[EpochDomain::global().local().index % num_stripes];
+    const auto pending = stripe.pending.fetch_add(delta, std::memory_order_relaxed) + delta;
+    if (static_cast<size_t>(pending < 0 ? -pending : pending) > slack) {
+        total.fetch_add(stripe.pending.exchange(0, std::memory_order_relaxed));
+    }
+}
+
+inline size_t StripedCounter::approx() const {
+    return clamp(total.load());
+}
+
+inline size_t StripedCounter::exact() const {
+    auto count = total.load();
+    for (const auto& stripe : stripes) {
+        count += stripe.pending.load();
+    }
+    return clamp(count);
+}
+
+} // namespace lh
+
+#endif //MVCC_LINEAR_HASHTABLE_COUNTER_H
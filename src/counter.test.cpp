@@ -0,0 +1,52 @@
+#include <catch2/catch.hpp>
+#include "counter.h"
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("Striped counter") {
+    SECTION("No slack is exact") {
+        lh::StripedCounter counter;
+        counter.add(3, 0);
+        counter.add(-1, 0);
+        REQUIRE(counter.approx() == 2);
+        REQUIRE(counter.exact() == 2);
+    }
+
+    SECTION("Approximate read lags by at most the slack") {
+        lh::StripedCounter counter;
+        for (int i = 0; i < 8; ++i) counter.add(1, 8);
+        REQUIRE(counter.approx() == 0);     // still pending in this thread's stripe
+        REQUIRE(counter.exact() == 8);
+
+        counter.add(1, 8);
+        REQUIRE(counter.approx() == 9);     // folded once past the slack
+        REQUIRE(counter.exact() == 9);
+    }
+
+    SECTION("Removes on another thread never underflow") {
+        lh::StripedCounter counter;
+        counter.add(5, 100);
+        std::thread([&]() { counter.add(-5, 100); }).join();
+        REQUIRE(counter.exact() == 0);
+        REQUIRE(counter.approx() == 0);
+    }
+
+    SECTION("Concurrent adds") {
+        lh::StripedCounter counter;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; ++t) {
+            threads.emplace_back([&counter]() {
+                for (int i = 0; i < 10000; ++i) {
+                    counter.add(2, 32);
+                    counter.add(-1, 32);
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+
+        REQUIRE(counter.exact() == 80000);
+        REQUIRE(counter.approx() <= 80000);
+        REQUIRE(counter.approx() >= 80000 - 16 * 33);
+    }
+}
@@ -0,0 +1,223 @@
+#ifndef MVCC_LINEAR_HASHTABLE_EPOCH_H
+#define MVCC_LINEAR_HASHTABLE_EPOCH_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Epoch based reclamation (EBR)
+// Readers pin the global epoch for the length of one operation and take no locks.
+// Writers unlink memory then retire it tagged with the current epoch, it is freed
+// once the global epoch has moved 2 past that tag, by then no reader can still see it.
+//
+// Publication pointers guarded by the epoch are loaded/stored seq_cst, which is what
+// orders a reader's announcement before its first protected load.
+namespace lh {
+
+class EpochDomain {
+public:
+    struct alignas(64) Record {    // one per thread, own cache line so pins never bounce
+        std::atomic<uint64_t> epoch{0};    // 0 == not pinned
+        std::atomic<bool> in_use{true};
+        Record* next = nullptr;
+        size_t index = 0;
+        size_t nest = 0;    // owning thread only
+    };
+
+    static EpochDomain& global() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    Record& local();
+
+    void pin(Record& rec);
+    void unpin(Record& rec);
+
+    uint64_t current() const { return global_epoch.load(); }
+    bool try_advance();
+    void synchronize();     // waits out every reader pinned before the call, never call pinned
+
+private:
+    std::atomic<uint64_t> global_epoch{1};
+    std::atomic<Record*> records{nullptr};  // never freed, reused after thread exit
+    std::atomic<size_t> num_records{0};
+
+    EpochDomain() = default;
+    Record& acquire();
+};
+
+// RAII pin, nests freely
+class EpochGuard {
+public:
+    EpochGuard() : _rec(EpochDomain::global().local()) { EpochDomain::global().pin(_rec); }
+    ~EpochGuard() { EpochDomain::global().unpin(_rec); }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+private:
+    EpochDomain::Record& _rec;
+};
+
+// Per container retire list, striped by thread so writers rarely share a lock.
+// Destroying it frees everything still pending, owner guarantees no readers remain.
+class Reclaimer {
+public:
+    using Deleter = void (*)(void*);
+
+    Reclaimer() = default;
+    ~Reclaimer();
+
+    Reclaimer(const Reclaimer&) = delete;
+    Reclaimer& operator=(const Reclaimer&) = delete;
+
+    template <typename T>
+    void retire(const T* ptr) {
+        retire(const_cast<T*>(ptr), [](void* p) { delete static_cast<T*>(p); });
+    }
+    void retire(void* ptr, Deleter del);
+
+    void collect();     // free whatever is already safe
+
+private:
+    struct Retired {
+        void* ptr;
+        Deleter del;
+        uint64_t epoch;
+    };
+
+    struct alignas(64) Stripe {
+        std::mutex mutex;
+        std::vector<Retired> items;
+    };
+
+    static constexpr size_t num_stripes = 16;
+    static constexpr size_t collect_threshold = 64;    // retirements per stripe between scans
+
+    std::array<Stripe, num_stripes> stripes;
+
+    static void collect(Stripe& stripe, uint64_t now);
+};
+
+// IMPLEMENTATION===========================================
+namespace detail {
+    struct LocalRecord {    // returns the record for reuse on thread exit
+        EpochDomain::Record* rec = nullptr;
+        ~LocalRecord() {
+            if (rec) {
+                rec->epoch.store(0);
+                rec->in_use.store(false);
+            }
+        }
+    };
+}
+
+inline EpochDomain::Record& EpochDomain::local() {
+    thread_local detail::LocalRecord holder;
+    if (holder.rec == nullptr) {
+        holder.rec = &acquire();
+    }
+    return *holder.rec;
+}
+
+inline EpochDomain::Record& EpochDomain::acquire() {
+    for (auto* rec = records.load(); rec != nullptr; rec = rec->next) {
+        auto expected = false;
+        if (rec->in_use.compare_exchange_strong(expected, true)) {
+            return *rec;
+        }
+    }
+
+    auto* rec = new Record;
+    rec->index = num_records.fetch_add(1);
+    rec->next = records.load();
+    while (!records.compare_exchange_weak(rec->next, rec)) {}
+    return *rec;
+}
+
+inline void EpochDomain::pin(Record& rec) {
+    if (rec.nest++ == 0) {
+        // stale announcement is fine, it only holds the epoch back
+        rec.epoch.store(global_epoch.load());
+    }
+}
+
+inline void EpochDomain::unpin(Record& rec) {
+    if (--rec.nest == 0) {
+        rec.epoch.store(0);
+    }
+}
+
+inline bool EpochDomain::try_advance() {
+    auto e = global_epoch.load();
+    for (auto* rec = records.load(); rec != nullptr; rec = rec->next) {
+        const auto seen = rec->epoch.load();
+        if (seen != 0 && seen != e) {
+            return false;   // someone still reading in an older epoch
+        }
+    }
+    global_epoch.compare_exchange_strong(e, e + 1);    // losing the race means someone else advanced
+    return true;
+}
+
+inline void EpochDomain::synchronize() {
+    const auto target = current() + 2;
+    while (current() < target) {
+        if (!try_advance()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+inline Reclaimer::~Reclaimer() {
+    for (auto& stripe : stripes) {
+        for (auto& item : stripe.items) {
+            item.del(item.ptr);
+        }
+    }
+}
+
+inline void Reclaimer::retire(void* ptr, Deleter del) {
+    auto& domain = EpochDomain::global();
+    auto& stripe = stripes[domain.local().index % num_stripes];
+
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    stripe.items.push_back(Retired{ptr, del, domain.current()});
+
+    if (stripe.items.size() % collect_threshold == 0) {
+        domain.try_advance();
+        collect(stripe, domain.current());
+    }
+}
+
+inline void Reclaimer::collect() {
+    auto& domain = EpochDomain::global();
+    domain.try_advance();
+
+    for (auto& stripe : stripes) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        collect(stripe, domain.current());
+    }
+}
+
+inline void Reclaimer::collect(Stripe& stripe, uint64_t now) {
+    // items are appended in epoch order, free the safe prefix
+    auto& items = stripe.items;
+    auto safe = items.begin();
+    while (safe != items.end() && safe->epoch + 2 <= now) {
+        safe->del(safe->ptr);
+        ++safe;
+    }
+    items.erase(items.begin(), safe);
+}
+
+} // namespace lh
+
+#endif //MVCC_LINEAR_HASHTABLE_EPOCH_H
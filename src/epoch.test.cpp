@@ -0,0 +1,89 @@
+#include <catch2/catch.hpp>
+#include "epoch.h"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+namespace {
+    struct Tracked {    // flags its own destruction
+        std::atomic<int>* freed;
+        ~Tracked() { ++(*freed); }
+    };
+}
+
+TEST_CASE("Epoch guard") {
+    auto& domain = lh::EpochDomain::global();
+
+    SECTION("Pinned reader holds the epoch") {
+        std::atomic<bool> pinned{false};
+        std::atomic<bool> release{false};
+
+        std::thread reader([&]() {
+            lh::EpochGuard guard;
+            pinned = true;
+            while (!release) std::this_thread::yield();
+        });
+        while (!pinned) std::this_thread::yield();
+
+        domain.try_advance();   // at most one step past the reader
+        const auto held = domain.current();
+        domain.try_advance();
+        domain.try_advance();
+        REQUIRE(domain.current() == held);
+
+        release = true;
+        reader.join();
+        domain.synchronize();
+        REQUIRE(domain.current() >= held + 2);
+    }
+
+    SECTION("Nested guards") {
+        lh::EpochGuard outer;
+        {
+            lh::EpochGuard inner;
+        }
+        auto& rec = domain.local();
+        REQUIRE(rec.epoch.load() != 0); // still pinned by outer
+    }
+}
+
+TEST_CASE("Reclaimer") {
+    auto& domain = lh::EpochDomain::global();
+    std::atomic<int> freed{0};
+
+    SECTION("Deferred while a reader is pinned") {
+        lh::Reclaimer reclaimer;
+        std::atomic<bool> pinned{false};
+        std::atomic<bool> release{false};
+
+        std::thread reader([&]() {
+            lh::EpochGuard guard;
+            pinned = true;
+            while (!release) std::this_thread::yield();
+        });
+        while (!pinned) std::this_thread::yield();
+
+        reclaimer.retire(new Tracked{&freed});
+        for (int i = 0; i < 4; ++i) reclaimer.collect();
+        REQUIRE(freed == 0);
+
+        release = true;
+        reader.join();
+        domain.synchronize();
+        reclaimer.collect();
+        REQUIRE(freed == 1);
+    }
+
+    SECTION("Destructor frees pending") {
+        {
+            lh::Reclaimer reclaimer;
+            lh::EpochGuard guard;   // nothing can be collected while we are pinned
+            for (int i = 0; i < 100; ++i) {
+                reclaimer.retire(new Tracked{&freed});
+            }
+            REQUIRE(freed < 100);
+        }
+        REQUIRE(freed == 100);
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef MVCC_LINEAR_HASHTABLE_FINGERPRINT_H
+#define MVCC_LINEAR_HASHTABLE_FINGERPRINT_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Fingerprint tags (Swiss table style)
+// A block keeps one tag byte per entry, cut from its hash, in a dense array padded to
+// whole groups. A lookup compares a group of tags with its own in one go and only
+// compares keys where they agree. Groups are matched with AVX2 when the CPU has it,
+// else SSE2, else byte by byte, picked once at first use.
+namespace lh {
+
+constexpr size_t tag_group = 32;
+
+// the multiply folds every hash bit into the top byte, the low bits already pick the bucket
+inline uint8_t tag_of(size_t h) {
+    return static_cast<uint8_t>((static_cast<uint64_t>(h) * 0x9e3779b97f4a7c15ULL) >> 56);
+}
+
+// room for count tags, padded so every group load stays in bounds
+inline size_t tag_bytes(size_t count) {
+    return (count + tag_group - 1) / tag_group * tag_group;
+}
+
+// Calls visit(i) for each i < count where tags[i] == tag, in order, until one returns
+// true. Returns whether one did. tags must hold tag_bytes(count) bytes
+template <typename Visit>
+bool match_tags(const uint8_t* tags, size_t count, uint8_t tag, Visit visit);
+
+namespace detail {
+    using MatchGroup = uint32_t (*)(const uint8_t* group, uint8_t tag);  // bit i: group[i] == tag
+
+    inline uint32_t match_group_scalar(const uint8_t* group, uint8_t tag) {
+        uint32_t hits = 0;
+        for (size_t i = 0; i < tag_group; ++i) {
+            hits |= static_cast<uint32_t>(group[i] == tag) << i;
+        }
+        return hits;
+    }
+
+#if defined(__SSE2__)
+    inline uint32_t match_group_sse2(const uint8_t* group, uint8_t tag) {
+        const auto needle = _mm_set1_epi8(static_cast<char>(tag));
+        const auto low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        const auto high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group + 16));
+        const auto low_hits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, needle)));
+        const auto high_hits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(high, needle)));
+        return low_hits | high_hits << 16;
+    }
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define LH_HAVE_AVX2_DISPATCH 1
+    __attribute__((target("avx2"))) inline uint32_t match_group_avx2(const uint8_t* group, uint8_t tag) {
+        const auto needle = _mm256_set1_epi8(static_cast<char>(tag));
+        const auto tags = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(tags, needle)));
+    }
+
+    inline bool cpu_has_avx2() { return __builtin_cpu_supports("avx2"); }
+#else
+    inline bool cpu_has_avx2() { return false; }
+#endif
+
+    inline MatchGroup select_match_group() {
+#if defined(LH_HAVE_AVX2_DISPATCH)
+        if (cpu_has_avx2()) {
+            return match_group_avx2;
+        }
+#endif
+#if defined(__SSE2__)
+        return match_group_sse2;
+#else
+        return match_group_scalar;
+#endif
+    }
+
+    inline MatchGroup match_group() {
+        static const auto match = select_match_group();
+        return match;
+    }
+}
+
+// IMPLEMENTATION===========================================
+template <typename Visit>
+bool match_tags(const uint8_t* tags, size_t count, uint8_t tag, Visit visit) {
+    const auto match = detail::match_group();
+    for (size_t base = 0; base < count; base += tag_group) {
+        auto hits = match(tags + base, tag);
+        if (count - base < tag_group) {     // padding past the last tag never matches
+            hits &= (uint32_t{1} << (count - base)) - 1;
+        }
+        for (; hits != 0; hits &= hits - 1) {
+            if (visit(base + static_cast<size_t>(std::countr_zero(hits)))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace lh
+
+#endif //MVCC_LINEAR_HASHTABLE_FINGERPRINT_H
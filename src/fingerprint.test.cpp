@@ -0,0 +1,81 @@
+#include <catch2/catch.hpp>
+#include "fingerprint.h"
+
+#include <random>
+#include <vector>
+
+namespace {
+    std::vector<size_t> expected_hits(const std::vector<uint8_t>& tags, size_t count, uint8_t tag) {
+        std::vector<size_t> hits;
+        for (size_t i = 0; i < count; ++i) {
+            if (tags[i] == tag) hits.push_back(i);
+        }
+        return hits;
+    }
+}
+
+TEST_CASE("Fingerprint tags") {
+    SECTION("Padding rounds up to whole groups") {
+        REQUIRE(lh::tag_bytes(0) == 0);
+        REQUIRE(lh::tag_bytes(1) == lh::tag_group);
+        REQUIRE(lh::tag_bytes(lh::tag_group) == lh::tag_group);
+        REQUIRE(lh::tag_bytes(lh::tag_group + 1) == 2 * lh::tag_group);
+    }
+
+    SECTION("Tags come from the high bits of the mixed hash") {
+        // hashes that differ only above the bucket bits still get different tags
+        REQUIRE(lh::tag_of(1) != lh::tag_of(2));
+        REQUIRE(lh::tag_of(size_t{1} << 40) != lh::tag_of(0));
+    }
+
+    SECTION("Every group matcher agrees with a byte compare") {
+        std::vector<lh::detail::MatchGroup> matchers{lh::detail::match_group_scalar, lh::detail::match_group()};
+#if defined(__SSE2__)
+        matchers.push_back(lh::detail::match_group_sse2);
+#endif
+#if defined(LH_HAVE_AVX2_DISPATCH)
+        if (lh::detail::cpu_has_avx2()) {
+            matchers.push_back(lh::detail::match_group_avx2);
+        }
+#endif
+
+        std::mt19937 rng(7);
+        std::vector<uint8_t> group(lh::tag_group);
+        for (int round = 0; round < 200; ++round) {
+            for (auto& tag : group) tag = static_cast<uint8_t>(rng() % 4);   // plenty of repeats
+            const auto tag = static_cast<uint8_t>(rng() % 4);
+
+            uint32_t want = 0;
+            for (size_t i = 0; i < lh::tag_group; ++i) {
+                if (group[i] == tag) want |= uint32_t{1} << i;
+            }
+            for (const auto match : matchers) {
+                REQUIRE(match(group.data(), tag) == want);
+            }
+        }
+    }
+
+    SECTION("Visits matches in order and ignores padding") {
+        const size_t count = 45;
+        std::vector<uint8_t> tags(lh::tag_bytes(count), 9);     // padding would match too
+        for (size_t i = 0; i < count; ++i) tags[i] = static_cast<uint8_t>(i % 3 == 0 ? 9 : i);
+
+        std::vector<size_t> seen;
+        REQUIRE_FALSE(lh::match_tags(tags.data(), count, 9, [&](size_t i) {
+            seen.push_back(i);
+            return false;
+        }));
+        REQUIRE(seen == expected_hits(tags, count, 9));
+    }
+
+    SECTION("Stops at the first accepted match") {
+        std::vector<uint8_t> tags(lh::tag_bytes(40), 5);
+        size_t visits = 0;
+        REQUIRE(lh::match_tags(tags.data(), 40, 5, [&](size_t i) {
+            ++visits;
+            return i == 33;
+        }));
+        REQUIRE(visits == 34);
+        REQUIRE_FALSE(lh::match_tags(tags.data(), 0, 5, [](size_t) { return true; }));
+    }
+}
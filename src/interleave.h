@@ -0,0 +1,139 @@
+#ifndef MVCC_LINEAR_HASHTABLE_INTERLEAVE_H
+#define MVCC_LINEAR_HASHTABLE_INTERLEAVE_H
+
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Interleaved execution (AMAC style)
+// A pointer chasing operation is written as a coroutine that prefetches its next hop
+// and suspends. interleave() keeps a group of them in flight and resumes them round
+// robin, so each one's cache miss is served while the others run.
+namespace lh {
+
+namespace detail {
+    inline void prefetch(const void* addr) {
+#if defined(__GNUC__)
+        __builtin_prefetch(addr);
+#else
+        (void)addr;
+#endif
+    }
+}
+
+// co_await Prefetch{p}: start loading p, let the other lookups run meanwhile
+struct Prefetch {
+    const void* addr;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<>) const noexcept { detail::prefetch(addr); }
+    void await_resume() const noexcept {}
+};
+
+// Lazily started, resumed by hand, owns its frame
+template <typename T>
+class Task {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::exception_ptr error;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_value(T result) { value.emplace(std::move(result)); }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task() = default;
+    Task(Task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task() { reset(); }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool valid() const { return _handle != nullptr; }
+    bool done() const { return _handle.done(); }
+    void resume() { _handle.resume(); }
+    T result();     // once done, rethrows what the body threw
+
+private:
+    std::coroutine_handle<promise_type> _handle = nullptr;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+    void reset() {
+        if (_handle) {
+            _handle.destroy();
+            _handle = nullptr;
+        }
+    }
+};
+
+// Runs make(0) .. make(count - 1) with at most in_flight suspended at once, handing
+// each result to sink(i, result) as it completes. in_flight must be positive
+template <typename MakeTask, typename Sink>
+void interleave(size_t count, size_t in_flight, MakeTask make, Sink sink);
+
+// IMPLEMENTATION===========================================
+template <typename T>
+T Task<T>::result() {
+    auto& promise = _handle.promise();
+    if (promise.error) {
+        std::rethrow_exception(promise.error);
+    }
+    return std::move(*promise.value);
+}
+
+template <typename MakeTask, typename Sink>
+void interleave(size_t count, size_t in_flight, MakeTask make, Sink sink) {
+    using TaskType = decltype(make(size_t{0}));
+
+    struct Slot {
+        TaskType task;
+        size_t index = 0;
+    };
+
+    std::vector<Slot> ring(std::min(in_flight, count));
+    size_t next = 0;
+    for (auto& slot : ring) {
+        slot.task = make(next);
+        slot.index = next++;
+    }
+
+    // a finished slot takes the next operation, the ring drains once none are left
+    for (size_t active = ring.size(); active != 0;) {
+        for (auto& slot : ring) {
+            if (!slot.task.valid()) {
+                continue;
+            }
+
+            slot.task.resume();
+            if (!slot.task.done()) {
+                continue;
+            }
+
+            sink(slot.index, slot.task.result());
+            if (next < count) {
+                slot.task = make(next);
+                slot.index = next++;
+            } else {
+                slot.task = TaskType{};
+                --active;
+            }
+        }
+    }
+}
+
+} // namespace lh
+
+#endif //MVCC_LINEAR_HASHTABLE_INTERLEAVE_H
@@ -0,0 +1,71 @@
+#include <catch2/catch.hpp>
+#include "interleave.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// GCC flags the frame setup it generates for every coroutine
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+namespace {
+    // suspends steps times, recording the order it runs in
+    lh::Task<int> stepper(int id, int steps, std::vector<int>& trace) {
+        for (int i = 0; i < steps; ++i) {
+            trace.push_back(id);
+            co_await lh::Prefetch{&trace};
+        }
+        co_return id * 10;
+    }
+
+    lh::Task<std::string> thrower() {
+        co_await lh::Prefetch{nullptr};
+        throw std::runtime_error("boom");
+    }
+}
+#pragma GCC diagnostic pop
+
+TEST_CASE("Interleave") {
+    SECTION("Task runs lazily to completion") {
+        std::vector<int> trace;
+        auto task = stepper(1, 2, trace);
+        REQUIRE(trace.empty());
+
+        task.resume();
+        task.resume();
+        REQUIRE_FALSE(task.done());
+        task.resume();
+        REQUIRE(task.done());
+        REQUIRE(task.result() == 10);
+        REQUIRE(trace == std::vector<int>{1, 1});
+    }
+
+    SECTION("Exceptions surface from result") {
+        auto task = thrower();
+        while (!task.done()) task.resume();
+        REQUIRE_THROWS_AS(task.result(), std::runtime_error);
+    }
+
+    SECTION("Round robin across the ring") {
+        std::vector<int> trace;
+        std::vector<int> results(5, -1);
+        lh::interleave(5, 2,
+            [&](size_t i) { return stepper(static_cast<int>(i), 2, trace); },
+            [&](size_t i, int value) { results[i] = value; });
+
+        REQUIRE(results == std::vector<int>{0, 10, 20, 30, 40});
+        REQUIRE(trace == std::vector<int>{0, 1, 0, 1, 2, 3, 2, 3, 4, 4});
+    }
+
+    SECTION("More slots than work, and no work") {
+        std::vector<int> trace;
+        int completed = 0;
+        lh::interleave(3, 64, [&](size_t i) { return stepper(static_cast<int>(i), 1, trace); },
+            [&](size_t, int) { ++completed; });
+        REQUIRE(completed == 3);
+
+        lh::interleave(0, 4, [&](size_t i) { return stepper(static_cast<int>(i), 1, trace); },
+            [&](size_t, int) { ++completed; });
+        REQUIRE(completed == 3);
+    }
+}
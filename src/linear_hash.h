@@ -10,48 +10,400 @@
 #include <stdexcept>
 #include <mutex>
 #include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <cmath>
 #include <atomic>
+#include <array>
 #include <iterator>
+#include <bit>
+#include <new>
+#include <type_traits>
+#include <span>
+#include <utility>
+#include <set>
+#include <cstdint>
+#include <exception>
 
-template <typename K, typename V>
+#include "epoch.h"
+#include "counter.h"
+#include "interleave.h"
+#include "fingerprint.h"
+#include "locks.h"
+#include "parallel.h"
+
+namespace lh::detail {
+    // T can be copied with one lock free atomic access
+    template <typename T>
+    struct atomic_ref_lock_free : std::bool_constant<
+        std::atomic_ref<T>::is_always_lock_free && alignof(T) >= std::atomic_ref<T>::required_alignment> {};
+
+    template <typename T>
+    inline constexpr bool atomic_copyable = std::conjunction_v<
+        std::is_trivially_copyable<T>, atomic_ref_lock_free<T>>;
+
+    template <typename T>
+    T load_acquire(const T& src) {
+        return std::atomic_ref<T>(const_cast<T&>(src)).load(std::memory_order_acquire);
+    }
+
+    template <typename T>
+    void store_release(T& dst, const T& val) {
+        std::atomic_ref<T>(dst).store(val, std::memory_order_release);
+    }
+
+    // an entry's copy of its key's hash, empty when not cached
+    template <bool Cached>
+    struct StoredHash {
+        size_t value;
+        StoredHash(size_t h) : value(h) {}
+    };
+
+    template <>
+    struct StoredHash<false> {
+        StoredHash(size_t) {}
+    };
+}
+
+namespace lh {
+    // Whether entries keep their key's hash, so splits never rehash and lookups skip most
+    // key compares. As libstdc++ decides: cache unless hashing is cheap and cannot throw.
+    // Specialise to override for a key type
+    template <typename K, typename Hash>
+    struct cache_hash : std::bool_constant<
+        !(std::is_scalar_v<K> && std::is_nothrow_invocable_v<const Hash&, const K&>)> {};
+
+    // Whether entries blocks carry a fingerprint tag per entry for vector matched lookups.
+    // Tags are cut from the cached hash, so by default wherever hashes are cached
+    template <typename K, typename Hash>
+    struct fingerprint_tags : cache_hash<K, Hash> {};
+}
+
+// Hash, KeyEqual and Allocator as for std::unordered_map. Allocator is rebound to supply
+// the entries blocks, the bulk of the table's memory. Lock is the bucket lock, see
+// locks.h. lh::NoLock drops the table lock as well, for tables written by one thread,
+// and lh::BravoLock biases it to its shared side too
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>,
+          typename Allocator = std::allocator<std::pair<const K, V>>, typename Lock = lh::SharedFutex>
 class LinearHash {
+public:
+    // Optimistic buckets: writers edit contents in place, bracketed by a seqlock style
+    // Bucket::version, and readers retry if it moved. Other types copy on write instead
+    static constexpr bool optimistic = lh::detail::atomic_copyable<K> && lh::detail::atomic_copyable<V>;
+    static constexpr bool cache_hashes = lh::cache_hash<K, Hash>::value;
+
+    // Tagged blocks: lookups match a whole group of tags at once and compare keys only
+    // where they agree. Needs cached hashes, and copy on write since in place edits
+    // would race the vector loads
+    static constexpr bool tagged = lh::fingerprint_tags<K, Hash>::value && cache_hashes && !optimistic;
+
 private:
     struct Entry {
         K key;
         V value;
+        [[no_unique_address]] lh::detail::StoredHash<cache_hashes> hash;
+    };
+
+    // entries blocks are counted in units aligned for both the header and the entries
+    struct alignas(std::max(alignof(Entry), alignof(std::max_align_t))) Unit {
+        unsigned char bytes[std::max(alignof(Entry), alignof(std::max_align_t))];
+    };
+    using UnitAlloc = typename std::allocator_traits<Allocator>::template rebind_alloc<Unit>;
+    using UnitTraits = std::allocator_traits<UnitAlloc>;
+
+    class Entries;
+    struct Destroy {
+        void operator()(Entries* entries) const { Entries::destroy(entries); }
+    };
+    using Entries_ptr = std::unique_ptr<Entries, Destroy>;
+
+    class Entries {     // header and entries share one allocation
+    public:
+        static Entries_ptr make(size_t capacity, const UnitAlloc& alloc);
+        static Entries* emplace(void* where, size_t capacity, const UnitAlloc& alloc);  // caller owns the memory
+        static Entries_ptr make(const Entries& from, size_t capacity);  // copy, same allocator
+        static void destroy(Entries* entries);
+
+        size_t size() const { return _size.load(std::memory_order_acquire); }
+        size_t capacity() const { return _capacity; }
+        bool empty() const { return size() == 0; }
+
+        Entry* begin() { return data(); }
+        Entry* end() { return data() + size(); }
+        const Entry* begin() const { return data(); }
+        const Entry* end() const { return data() + size(); }
+
+        Entry& operator[](size_t i) { return data()[i]; }
+        const Entry& operator[](size_t i) const { return data()[i]; }
+        const Entry& at(size_t i) const;
+        Entry& back() { return data()[size() - 1]; }
+
+        void push_back(const Entry& entry);    // size() < capacity(), unpublished only
+        void push_back(Entry&& entry);
+        void pop_back();
+        void remove_at(size_t i);   // last entry moves into i, unpublished only
+
+        // one per entry while tagged, padded to whole groups
+        uint8_t* tags() { return reinterpret_cast<uint8_t*>(this) + header_bytes(); }
+        const uint8_t* tags() const { return reinterpret_cast<const uint8_t*>(this) + header_bytes(); }
+
+        // in place edits for optimistic buckets, readers may be scanning concurrently
+        void overwrite(size_t i, const V& value);
+        void append(const Entry& entry);   // size() < capacity()
+        void erase(size_t i);   // last entry moves into i
+        void assign(const Entries& from);   // from.size() <= capacity()
+
+        // MVCC: publish time, and the version this one replaced while snapshots need it
+        uint64_t ts = 0;
+        std::atomic<Entries*> prev{nullptr};
+
+    private:
+        const size_t _capacity;
+        std::atomic<size_t> _size;
+        [[no_unique_address]] UnitAlloc _alloc;     // frees the block, no space when stateless
+
+        Entries(size_t capacity, const UnitAlloc& alloc) : _capacity(capacity), _size(0), _alloc(alloc) {}
+
+        // header, then the tags if any, then the entries
+        static size_t header_bytes() { return sizeof(Entries); }
+        static size_t tag_bytes(size_t capacity) { return tagged ? lh::tag_bytes(capacity) : 0; }
+        static size_t data_offset(size_t capacity);
+        void store(size_t i, const Entry& entry);   // for concurrent readers
+        static size_t units(size_t capacity) {
+            return (data_offset(capacity) + capacity * sizeof(Entry) + sizeof(Unit) - 1) / sizeof(Unit);
+        }
+        Entry* data() { return reinterpret_cast<Entry*>(reinterpret_cast<char*>(this) + data_offset(_capacity)); }
+        const Entry* data() const {
+            return reinterpret_cast<const Entry*>(reinterpret_cast<const char*>(this) + data_offset(_capacity));
+        }
     };
 
-    struct Bucket {
-        std::vector<Entry> entries;
-        mutable std::shared_mutex mutex;
+    // Optimistic buckets embed an entries block that small contents are copied back into,
+    // so a lookup finds the keys on the bucket's own cache lines instead of one hop further.
+    // Sized to fill two lines with the fields ahead of it. Copy on write buckets could
+    // never rewrite it under their readers, they have none
+    static constexpr size_t cache_line = 64;
+    static constexpr size_t bucket_fields =    // entries, version, mutex
+        (sizeof(std::atomic<Entries*>) + sizeof(std::atomic<size_t>) + sizeof(Lock) + alignof(UnitAlloc) - 1) /
+        alignof(UnitAlloc) * alignof(UnitAlloc);
+    static constexpr size_t bucket_header =    // and the allocator, when it has state
+        (bucket_fields + (std::is_empty_v<UnitAlloc> ? 0 : sizeof(UnitAlloc)) + alignof(Unit) - 1) /
+        alignof(Unit) * alignof(Unit);
+    static constexpr size_t inline_header = (sizeof(Entries) + alignof(Entry) - 1) / alignof(Entry) * alignof(Entry);
+    static constexpr size_t inline_room = 2 * cache_line - bucket_header;
+    static constexpr size_t inline_capacity =
+        optimistic && inline_header < inline_room ? (inline_room - inline_header) / sizeof(Entry) : 0;
+
+    struct InlineBlock {
+        alignas(Unit) unsigned char bytes[inline_header + inline_capacity * sizeof(Entry)];
     };
+    struct NoInlineBlock {};
 
-    using Bucket_ptr = std::unique_ptr<Bucket>; // memory optimisation
-    std::vector<Bucket_ptr> table;
+    struct alignas(cache_line) Bucket {
+        // published contents. Writers copy, publish, retire, unless optimistic
+        std::atomic<Entries*> entries;
+        std::atomic<size_t> version{0};     // odd while an in place edit is running
+        mutable Lock mutex;     // serialises writers, readers go through the epoch
+        [[no_unique_address]] UnitAlloc _alloc;     // the bucket came from it too
+        [[no_unique_address]] std::conditional_t<(inline_capacity > 0), InlineBlock, NoInlineBlock> inline_block;
+
+        // starts empty, in the inline block if there is one
+        Bucket(const UnitAlloc& alloc, uint64_t ts) : _alloc(alloc) {
+            Entries* first = nullptr;
+            if constexpr (inline_capacity > 0) {
+                first = Entries::emplace(inline_block.bytes, inline_capacity, alloc);
+            } else {
+                first = Entries::make(0, alloc).release();
+            }
+            first->ts = ts;
+            entries.store(first);
+        }
+        ~Bucket() {
+            for (auto* version = entries.load(); version != nullptr;) {
+                auto* older = version->prev.load();
+                if (version != inline_entries()) {
+                    Entries::destroy(version);
+                }
+                version = older;
+            }
+        }
+
+        Entries* inline_entries() {     // nullptr without one
+            if constexpr (inline_capacity > 0) {
+                return std::launder(reinterpret_cast<Entries*>(inline_block.bytes));
+            } else {
+                return nullptr;
+            }
+        }
+    };
+    // a header too big to leave room for one entry gets no inline block, and no sizing claim
+    static_assert(!optimistic || inline_capacity == 0 || sizeof(Bucket) == 2 * cache_line,
+                  "an inline bucket must fill exactly two cache lines");
+
+    // Segmented directory: segment 0 holds init_size slots, segment s > 0 holds
+    // init_size << (s - 1). Segments are allocated on first use and never move, so growth
+    // is O(1) and indexing needs no lock
+    using Slot = std::atomic<Bucket*>;
+    static constexpr size_t max_segments = 64;
+    std::array<std::atomic<Slot*>, max_segments> table;
+
+    [[no_unique_address]] Hash hash_fn;
+    [[no_unique_address]] KeyEqual equal_fn;
+    [[no_unique_address]] UnitAlloc alloc;
 
     double max_load_factor;
-    std::atomic<size_t> num_elem;
+    std::atomic<double> min_load_factor;    // contraction low water mark, 0 == never merge
 
-    size_t split_ptr;           // current/next bucket to split
+    // Writers only touch their own stripe once the table is large, the fast path tests
+    // the approximate count and splits/merges re-check the exact one
+    lh::StripedCounter num_elem;
+
+    // bucket count, the only split state. split_ptr and depth are derived from it so
+    // readers get a consistent pair from one load
+    std::atomic<size_t> num_buckets;
     const size_t init_size;   // starting size(2)
-    size_t depth;       // hash depth, init_size << depth == post_split size
 
-    mutable std::shared_mutex global_mutex;
+    // A split opens the new bucket empty and then migrates the source's keys into it.
+    // While that runs, migrating names the new bucket and lookups of its keys check the
+    // source too. 0 == none, bucket 0 is never split into
+    std::atomic<size_t> migrating{0};
+    std::atomic<size_t> split_step{0};  // source entries examined per insert/remove, 0 == whole bucket
+    size_t migrate_cursor = 0;  // in place steps: source entries from here on stay. Source lock
+    static constexpr size_t max_step = static_cast<size_t>(-1);
+
+    // Contraction merges the last bucket back into its source and retires it. The count
+    // alone would let a merge then a split look like nothing happened, so lookups that
+    // miss also check this never reused number
+    std::atomic<size_t> merges{0};
+
+    // MVCC clock: versions are stamped with clock + 1 when published, a snapshot bumps it
+    // and reads the newest version stamped at or before its own time
+    std::atomic<uint64_t> clock{0};
+    std::atomic<size_t> live_snapshots{0};  // nonzero: keep old versions, no in place edits, no merges
+    std::mutex snapshot_mutex;
+    std::multiset<uint64_t> snapshots;      // live snapshot times, for the collector
+
+    // every writer takes it shared and only whole table ops take it exclusively, so its
+    // readers are striped by thread. A reader biased policy biases it as well
+    using GlobalLock = std::conditional_t<std::is_same_v<Lock, lh::NoLock>, lh::NoLock,
+        std::conditional_t<lh::is_reader_biased<Lock>, lh::BravoLock<lh::StripedSharedMutex>, lh::StripedSharedMutex>>;
+    mutable GlobalLock global_mutex;    // writers shared, whole table ops exclusive. readers never
+    // one split at a time, never held by plain writers or readers. Compiled out with the rest
+    using SplitLock = std::conditional_t<std::is_same_v<Lock, lh::NoLock>, lh::NoLock, std::mutex>;
+    SplitLock split_mutex;
+    lh::Reclaimer reclaimer;
+
+    // optional background split worker, inserts only signal it
+    std::thread split_worker;
+    std::mutex worker_control;  // serialises start/stop
+    std::mutex worker_mutex;
+    std::condition_variable worker_cv;
+    std::atomic<bool> background_splits{false};
+    std::atomic<bool> split_pending{false};
+    std::atomic<bool> collect_pending{false};
+    std::atomic<bool> worker_stop{false};
 
-    size_t hash2bucket(const K& key) const;
-    bool split_cond() const;
+    // Without the worker, releasing a snapshot restarts a pass over the buckets that the
+    // writes after it run collect_chunk buckets at a time. Past the last bucket == no pass
+    static constexpr size_t collect_chunk = 64;
+    std::atomic<size_t> collect_next{max_step};
+
+    size_t depth_of(size_t buckets) const;    // init_size << depth <= buckets < init_size << (depth + 1)
+    size_t hash2bucket(size_t h, size_t buckets) const;
+    size_t count_slack() const { return num_buckets.load() >> 10; }   // load drifts < 1/64
+    bool split_cond(size_t elems) const;
+    bool merge_cond(size_t elems) const;
+
+    // buckets are allocated like the entries blocks, so an allocator places all of a table
+    using BucketAlloc = typename std::allocator_traits<Allocator>::template rebind_alloc<Bucket>;
+    using BucketTraits = std::allocator_traits<BucketAlloc>;
+    Bucket* make_bucket(uint64_t ts) const;
+    static void destroy_bucket(Bucket* bucket);
+
+    Slot& slot_at(size_t i) const;
+    Bucket& bucket_at(size_t i) const { return *slot_at(i).load(); }
+    void append(Bucket* bucket, size_t i);
+    void publish(Bucket& bucket, Entries_ptr next) { publish(bucket, std::move(next), stamp()); }
+    void publish(Bucket& bucket, Entries_ptr next, uint64_t ts);
+    void retire_entries(Bucket& bucket, Entries* entries);
+    uint64_t stamp() const { return clock.load() + 1; }
+    bool versioning() const { return live_snapshots.load() != 0; }
+    size_t source_of(size_t i) const { return i - (init_size << depth_of(i)); }   // bucket i split from
+    bool filling(size_t i) const { return i != 0 && migrating.load() == i; }
+
+    struct Locked {     // what a writer holds: its bucket and, while it fills, the split source
+        Bucket* bucket = nullptr;
+        Bucket* source = nullptr;
+        std::unique_lock<Lock> source_lock;
+        std::unique_lock<Lock> bucket_lock;
+    };
+    void lock_bucket(size_t h, Locked& locked) const;
+
+    // h is hash_fn(key), entries compare it first when cached
+    bool matches(const Entry& entry, const K& key, size_t h) const;
+    size_t hash_of(const Entry& entry) const;
+
+    // writer edits, caller holds the bucket lock
+    bool update_entry(Bucket& bucket, const K& key, size_t h, const V& val);
+    void push_entry(Bucket& bucket, const Entry& entry);
+    bool erase_entry(Bucket& bucket, const K& key, size_t h);
+    template <typename Pair>
+    void insert_many(std::span<Pair> items);    // moves out of non const pairs
+    template <typename Pair>
+    void insert_chunk(std::span<Pair> items);   // no more items than buckets
+
+    void split();
+    void open_split();
+    bool migrate(size_t max_entries);   // true once the open split is complete
+    void migrate_step(size_t max_entries);  // from a writer that has dropped its locks
+    void merge();
+    void signal_split();
+    void split_worker_loop();
+    void release_snapshot(uint64_t ts);
+    void prune_versions(Bucket& bucket, const std::vector<uint64_t>& live, uint64_t horizon);
+    // caller is pinned and holds the global lock shared
+    void collect_range(size_t first, size_t last, const std::vector<uint64_t>& live, uint64_t horizon);
+    void collect_step();    // from a writer that has dropped its locks
+    static void begin_write(Bucket& bucket);
+    static void end_write(Bucket& bucket);
+
+    // lookups, caller holds an EpochGuard
+    const Entry* scan(const Entries& entries, const K& key, size_t h) const;
+    const Entry* scan(const Bucket& bucket, const K& key, size_t h) const {
+        return scan(*bucket.entries.load(), key, h);
+    }
+    std::optional<V> scan_optimistic(const Bucket& bucket, const K& key, size_t h) const;
+    const Entry* find(const K& key, size_t h) const;
+    std::optional<V> find_optimistic(const K& key, size_t h) const;
+    std::optional<V> lookup(const K& key, size_t h) const;    // caller is pinned
+
+    // parallel scans: chunks of buckets handed out per worker, idle workers steal half
+    // of another's remaining range. visit(worker, entries) runs under the bucket read lock
+    static constexpr size_t parallel_chunk = 64;
+    size_t worker_count(size_t requested) const;
+    template <typename Visit>
+    void parallel_buckets(size_t workers, const Visit& visit) const;
+
+    static const Entries* version_at(const Bucket& bucket, uint64_t ts);
+    std::optional<V> find_at(const K& key, uint64_t ts) const;
+
+    static constexpr size_t prefetch_window = 16;   // lookups in flight per get_many pass
+    lh::Task<std::optional<V>> lookup_steps(const K& key) const;    // caller is pinned
 
 public:
     //===== WARNING: Iterators are not thread safe! =====
+    // scan a snapshot() for a consistent view alongside writers
     class Iterator {
     private:
         const LinearHash* _hm;
         size_t _bucket_idx;
         size_t _entry_idx;
 
+        const Entries& entries() const { return *_hm->bucket_at(_bucket_idx).entries.load(); }
+
         void go2data() {    //helper to skip empty bucket
-            while (_bucket_idx < _hm->table.size()) {
-                if (!(_hm->table.at(_bucket_idx)->entries.empty())) {
+            while (_bucket_idx < _hm->get_table_size()) {
+                if (!(entries().empty())) {
                     return;
                 }
                 ++_bucket_idx;
@@ -67,22 +419,22 @@ public:
 
         Iterator(const LinearHash* hm, size_t bucket_idx, size_t entry_idx)
             : _hm(hm), _bucket_idx(bucket_idx), _entry_idx(entry_idx) {
-            if (_bucket_idx < _hm->table.size() && _hm->table.at(_bucket_idx)->entries.empty()) {
+            if (_bucket_idx < _hm->get_table_size() && entries().empty()) {
                 go2data();
             }
         }
 
         reference operator*() const {
-            return _hm->table.at(_bucket_idx)->entries.at(_entry_idx);
+            return entries().at(_entry_idx);
         }
 
         pointer operator->() const {
-            return &(_hm->table.at(_bucket_idx)->entries.at(_entry_idx));
+            return &(entries().at(_entry_idx));
         }
 
         Iterator& operator++() {
             ++_entry_idx;
-            if (_entry_idx >= _hm->table.at(_bucket_idx)->entries.size()) {
+            if (_entry_idx >= entries().size()) {
                 _entry_idx = 0;
                 ++_bucket_idx;
             }
@@ -109,41 +461,369 @@ public:
     };
     // Iterator end =============================
 
-    explicit LinearHash(size_t size = 2, double load_factor = 0.75);
+    // Point in time view, reads never block writers. While any snapshot is live, writers
+    // keep the versions they replace (and skip in place edits and merges) until the
+    // collector finds no snapshot can see them. Must not outlive the table
+    class Snapshot {
+    public:
+        // Thread safe scan of the snapshot's contents while writers and splits carry on.
+        // Holds no lock and no epoch between steps: the versions it walks are pinned by
+        // the snapshot itself, which must stay put (not moved from) while iterating
+        class Iterator {
+        private:
+            const Snapshot* _snap;
+            size_t _bucket_idx;
+            size_t _entry_idx;
+            const Entries* _entries = nullptr;
+
+            void go2data() {    //helper to skip buckets empty, or not yet split off, at the snapshot
+                for (; _bucket_idx < _snap->_buckets; ++_bucket_idx) {
+                    _entries = _snap->visible(_bucket_idx);
+                    if (_entries != nullptr && !_entries->empty()) {
+                        return;
+                    }
+                }
+                _entries = nullptr;
+            }
+
+        public:
+            using value_type = Entry;
+            using pointer = const Entry*;
+            using reference = const Entry&;
+            using difference_type = std::ptrdiff_t;
+            using iterator_category = std::forward_iterator_tag;
+
+            Iterator(const Snapshot* snap, size_t bucket_idx) : _snap(snap), _bucket_idx(bucket_idx), _entry_idx(0) {
+                go2data();
+            }
+
+            reference operator*() const { return (*_entries)[_entry_idx]; }
+            pointer operator->() const { return &(*_entries)[_entry_idx]; }
+
+            Iterator& operator++() {
+                if (++_entry_idx >= _entries->size()) {
+                    _entry_idx = 0;
+                    ++_bucket_idx;
+                    go2data();
+                }
+                return *this;
+            }
+
+            Iterator operator++(int) {
+                auto tmp = *this;
+                ++(*this);
+                return tmp;
+            }
+
+            bool operator==(const Iterator& other) const {
+                return _snap == other._snap &&
+                    _bucket_idx == other._bucket_idx &&
+                    _entry_idx == other._entry_idx;
+            }
+
+            bool operator!=(const Iterator& other) const {
+                return !(*this == other);
+            }
+        };
+
+        Snapshot(Snapshot&& other) noexcept
+            : _hm(std::exchange(other._hm, nullptr)), _ts(other._ts), _buckets(other._buckets) {}
+        Snapshot& operator=(Snapshot&&) = delete;
+        ~Snapshot() {
+            if (_hm) {
+                _hm->release_snapshot(_ts);
+            }
+        }
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        std::optional<V> get(const K& key) const;
+        bool in(const K& key) const { return get(key).has_value(); }
+        uint64_t timestamp() const { return _ts; }
+
+        Iterator begin() const { return Iterator(this, 0); }
+        Iterator end() const { return Iterator(this, _buckets); }
+
+    private:
+        friend class LinearHash;
+        LinearHash* _hm;
+        uint64_t _ts;
+        size_t _buckets;    // every bucket past this was split off after the snapshot
+
+        Snapshot(LinearHash* hm, uint64_t ts, size_t buckets) : _hm(hm), _ts(ts), _buckets(buckets) {}
+        const Entries* visible(size_t i) const;     // this bucket's version at the snapshot, if any
+    };
+
+    explicit LinearHash(size_t size = 2, double load_factor = 0.75, const Hash& hash = Hash(),
+                        const KeyEqual& equal = KeyEqual(), const Allocator& allocator = Allocator());
+    ~LinearHash();
+
+    LinearHash(const LinearHash&) = delete;
+    LinearHash& operator=(const LinearHash&) = delete;
 
     void insert(const K& key, const V& val);
+
+    // Batched insert: keys are grouped by bucket so each bucket is locked (and copied, when
+    // not optimistic) once per chunk, and the split check runs once per chunk. Chunks are
+    // no larger than the table, which grows between them. Later duplicates win
+    void insert_batch(std::span<const std::pair<K, V>> items);
+    void insert_batch_move(std::span<std::pair<K, V>> items);  // leaves items moved from
+
     std::optional<V> get(const K& key) const;
     bool in(const K& key) const;
+
+    // Multi get: resolves the slot -> bucket -> entries chain one level at a time across a
+    // window of keys, prefetching the next level, so the cache misses overlap.
+    // results[i] is the value for keys[i]
+    void get_many(std::span<const K> keys, std::span<std::optional<V>> results) const;
+
+    // Coroutine multi get: each lookup suspends after prefetching its next hop and up to
+    // in_flight of them run interleaved, no hand batching needed. Same results as get_many
+    void get_interleaved(std::span<const K> keys, std::span<std::optional<V>> results,
+                         size_t in_flight = 32) const;
     bool remove(const K& key);
 
-    auto get_table_size() const{ return table.size(); }
-    auto get_num_elem() const { return num_elem.load(); }
-    auto get_split_ptr() const { return split_ptr; }
+    // Background splitting: inserts past the load factor (and removes under it) only wake
+    // the worker, which performs the splits and merges. Stopping hands them back
+    void start_split_worker();
+    void stop_split_worker();
+    bool split_worker_running() const { return background_splits.load(); }
+    size_t get_split_lag() const;   // splits still owed to the load factor
+
+    // Incremental splitting: a split only opens the new bucket, then every insert/remove
+    // examines at most max_entries of the source and moves the new bucket's keys over in
+    // place, so a call never does more than that on top of its own work. Copy on write
+    // buckets, and optimistic ones while a snapshot is live, would recopy both blocks every
+    // step: they still split whole. 0 restores whole bucket splits everywhere
+    void set_incremental_split(size_t max_entries);
+
+    // Contraction: a remove that leaves the load under min_load_factor merges the last
+    // bucket into its buddy. Must sit below the split threshold so the two cannot thrash,
+    // defaults to a quarter of it. 0 disables
+    void set_min_load_factor(double load_factor);
+
+    Hash hash_function() const { return hash_fn; }
+    KeyEqual key_eq() const { return equal_fn; }
+    Allocator get_allocator() const { return Allocator(alloc); }
+
+    auto get_table_size() const{ return num_buckets.load(); }
+    auto get_num_elem() const { return num_elem.exact(); }
+    auto get_split_ptr() const {
+        const auto n = num_buckets.load();
+        return n - (init_size << depth_of(n));
+    }
+
+    // Waits out writers already running, so never call it holding an EpochGuard
+    Snapshot snapshot();
+    // Frees versions no live snapshot can see. Runs on the worker when one is started,
+    // else spread over the inserts and removes that follow a snapshot's release
+    void collect_versions();
+
+    // Parallel scans over the buckets, fn(key, value) / fold(acc, key, value) may run on
+    // several threads at once. Each bucket is seen whole under its read lock, but entries
+    // a concurrent split or merge moves can be seen twice or not at all: scan a
+    // snapshot() for an exact view. nthreads 0 == hardware concurrency. Rethrows the
+    // first exception thrown by fn, once every worker has stopped
+    template <typename Fn>
+    void parallel_for_each(Fn fn, size_t nthreads = 0) const;
+    template <typename T, typename Fold, typename Combine>
+    T parallel_reduce(T identity, Fold fold, Combine combine, size_t nthreads = 0) const;
 
     Iterator begin() const { return Iterator(this, 0, 0); }
-    Iterator end() const { return Iterator(this, table.size(), 0);}
+    Iterator end() const { return Iterator(this, get_table_size(), 0);}
 
     void print() const;
 };
 
 // IMPLEMENTATION===========================================
-template <typename K, typename V>
-LinearHash<K, V>::LinearHash(size_t size, double load_factor)
-    : max_load_factor(load_factor), num_elem(0), split_ptr(0), init_size(size), depth(0) {
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+size_t LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::data_offset(size_t capacity) {
+    constexpr auto align = alignof(Entry);
+    return (header_bytes() + tag_bytes(capacity) + align - 1) / align * align;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+auto LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::make(size_t capacity, const UnitAlloc& alloc) -> Entries_ptr {
+    static_assert(alignof(Entries) <= alignof(Unit));
+    auto unit_alloc = alloc;
+    return Entries_ptr(emplace(std::to_address(UnitTraits::allocate(unit_alloc, units(capacity))), capacity, alloc));
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+auto LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::emplace(void* where, size_t capacity, const UnitAlloc& alloc)
+    -> Entries* {
+    auto* entries = new (where) Entries(capacity, alloc);
+    std::fill_n(entries->tags(), tag_bytes(capacity), uint8_t{0});
+    return entries;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+auto LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::make(const Entries& from, size_t capacity) -> Entries_ptr {
+    const auto n = from.size();
+    auto entries = make(std::max(capacity, n), from._alloc);
+    std::uninitialized_copy(from.begin(), from.begin() + n, entries->data());
+    if constexpr (tagged) {
+        std::copy_n(from.tags(), n, entries->tags());
+    }
+    entries->_size.store(n, std::memory_order_relaxed);
+    return entries;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::destroy(Entries* entries) {
+    auto alloc = entries->_alloc;
+    const auto count = units(entries->_capacity);
+    std::destroy(entries->begin(), entries->end());
+    entries->~Entries();
+
+    auto& first = *reinterpret_cast<Unit*>(entries);
+    UnitTraits::deallocate(alloc, std::pointer_traits<typename UnitTraits::pointer>::pointer_to(first), count);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+auto LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::at(size_t i) const -> const Entry& {
+    if (i >= size()) {
+        throw std::out_of_range("Entries::at");
+    }
+    return data()[i];
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::push_back(const Entry& entry) {
+    const auto n = size();
+    new (data() + n) Entry(entry);
+    if constexpr (tagged) {
+        tags()[n] = lh::tag_of(entry.hash.value);
+    }
+    _size.store(n + 1, std::memory_order_release);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::push_back(Entry&& entry) {
+    const auto n = size();
+    if constexpr (tagged) {
+        tags()[n] = lh::tag_of(entry.hash.value);
+    }
+    new (data() + n) Entry(std::move(entry));
+    _size.store(n + 1, std::memory_order_release);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::pop_back() {
+    const auto n = size() - 1;
+    std::destroy_at(data() + n);
+    _size.store(n, std::memory_order_release);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::remove_at(size_t i) {
+    // optimised vector del: std(O(n)) vs move(O(1)) + popback(O(1))
+    const auto last = size() - 1;
+    if (i != last) {
+        data()[i] = std::move(data()[last]);
+        if constexpr (tagged) {
+            tags()[i] = tags()[last];
+        }
+    }
+    pop_back();
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::overwrite(size_t i, const V& value) {
+    lh::detail::store_release(data()[i].value, value);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::store(size_t i, const Entry& entry) {
+    if constexpr (cache_hashes) {
+        lh::detail::store_release(data()[i].hash.value, entry.hash.value);
+    }
+    lh::detail::store_release(data()[i].key, entry.key);
+    lh::detail::store_release(data()[i].value, entry.value);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::append(const Entry& entry) {
+    const auto n = size();
+    store(n, entry);
+    _size.store(n + 1, std::memory_order_release);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::erase(size_t i) {
+    const auto last = size() - 1;
+    if (i != last) {
+        store(i, data()[last]);
+    }
+    _size.store(last, std::memory_order_release);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entries::assign(const Entries& from) {
+    const auto n = from.size();
+    for (size_t i = 0; i < n; ++i) {
+        store(i, from[i]);
+    }
+    _size.store(n, std::memory_order_release);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::LinearHash(size_t size, double load_factor, const Hash& hash,
+                                                        const KeyEqual& equal, const Allocator& allocator)
+    : table{}, hash_fn(hash), equal_fn(equal), alloc(allocator), max_load_factor(load_factor), min_load_factor(load_factor / 4), num_elem(),
+      num_buckets(0), init_size(size) {
     if (size == 0 || (size & (size - 1)) != 0) {
         throw std::invalid_argument("Initial size must be positive power of 2");
     }
 
-    table.reserve(init_size); // Performance optimization
     for (size_t i = 0; i < init_size; ++i) {
-        table.push_back(std::make_unique<Bucket>());
+        append(make_bucket(0), i);
     }
+    num_buckets.store(init_size);
 }
 
-template <typename K, typename V>
-size_t LinearHash<K, V>::hash2bucket(const K& key) const {
-    const auto h = std::hash<K>{}(key);
-    const auto pre_expansion_size = init_size << depth;
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::~LinearHash() {
+    stop_split_worker();
+
+    for (size_t i = 0; i < num_buckets.load(); ++i) {
+        destroy_bucket(slot_at(i).load());
+    }
+    for (auto& segment : table) {
+        delete[] segment.load();
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+auto LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::make_bucket(uint64_t ts) const -> Bucket* {
+    BucketAlloc bucket_alloc(alloc);
+    auto raw = BucketTraits::allocate(bucket_alloc, 1);
+    try {
+        return new (std::to_address(raw)) Bucket(alloc, ts);
+    } catch (...) {
+        BucketTraits::deallocate(bucket_alloc, raw, 1);
+        throw;
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::destroy_bucket(Bucket* bucket) {
+    BucketAlloc bucket_alloc(bucket->_alloc);
+    const auto raw = std::pointer_traits<typename BucketTraits::pointer>::pointer_to(*bucket);
+    bucket->~Bucket();
+    BucketTraits::deallocate(bucket_alloc, raw, 1);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+size_t LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::depth_of(size_t buckets) const {
+    return static_cast<size_t>(std::bit_width(buckets / init_size)) - 1;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+size_t LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::hash2bucket(size_t h, size_t buckets) const {
+    const auto pre_expansion_size = init_size << depth_of(buckets);
+    const auto split_ptr = buckets - pre_expansion_size;
 
     auto mask = pre_expansion_size - 1; // bitwise mask
     auto index = h & mask;
@@ -156,131 +836,1127 @@ size_t LinearHash<K, V>::hash2bucket(const K& key) const {
     return index;
 }
 
-template <typename K, typename V>
-bool LinearHash<K, V>::split_cond() const {
-    if (table.empty()) {
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+bool LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::split_cond(size_t elems) const {
+    const double load = static_cast<double>(elems) / static_cast<double>(num_buckets.load());
+    return load > max_load_factor;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+bool LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::merge_cond(size_t elems) const {
+    // a merge would move keys where snapshots, routing by the current count, cannot follow
+    const auto n = num_buckets.load();
+    if (n <= init_size || versioning()) {
         return false;
     }
 
-    const double load = static_cast<double>(num_elem) / static_cast<double>(table.size());
-    return load > max_load_factor;
+    // hysteresis: under the low water mark, and the merged table must not split straight back
+    const auto count = static_cast<double>(elems);
+    return count < min_load_factor.load() * static_cast<double>(n) &&
+        count <= max_load_factor * static_cast<double>(n - 1);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+typename LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Slot& LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::slot_at(size_t i) const {
+    const auto segment = static_cast<size_t>(std::bit_width(i / init_size));
+    const auto base = segment == 0 ? 0 : init_size << (segment - 1);
+    return table[segment].load()[i - base];
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::append(Bucket* bucket, size_t i) {
+    const auto segment = static_cast<size_t>(std::bit_width(i / init_size));
+    if (table[segment].load() == nullptr) {     // first slot of a segment, only splits get here
+        const auto slots = segment == 0 ? init_size : init_size << (segment - 1);
+        table[segment].store(new Slot[slots]());
+    }
+    slot_at(i).store(bucket);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::publish(Bucket& bucket, Entries_ptr next, uint64_t ts) {
+    next->ts = ts;
+    if (versioning()) {
+        next->prev.store(bucket.entries.load());
+        bucket.entries.store(next.release());
+        return;
+    }
+
+    Entries* head = nullptr;
+    if constexpr (inline_capacity > 0) {
+        if (next->size() <= inline_capacity) {
+            // small enough to move back inline. Readers still on the inline block retry
+            head = bucket.inline_entries();
+            begin_write(bucket);
+            head->assign(*next);
+            head->ts = ts;
+            end_write(bucket);
+        }
+    }
+    if (head == nullptr) {
+        head = next.release();
+    }
+
+    // no snapshot can want the replaced version, nor anything it still chains to
+    for (auto* version = bucket.entries.exchange(head); version != nullptr;) {
+        auto* older = version->prev.load();
+        retire_entries(bucket, version);
+        version = older;
+    }
+    head->prev.store(nullptr);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::retire_entries(Bucket& bucket, Entries* entries) {
+    if (entries == bucket.inline_entries()) {
+        return;     // lives as long as the bucket
+    }
+    reclaimer.retire(entries, [](void* p) {
+        Entries::destroy(static_cast<Entries*>(p));
+    });
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::begin_write(Bucket& bucket) {
+    // relaxed is enough, the release stores of the edit itself cannot move above it
+    bucket.version.store(bucket.version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::end_write(Bucket& bucket) {
+    bucket.version.store(bucket.version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::lock_bucket(size_t h, Locked& locked) const {
+    for (;;) {
+        const auto i = hash2bucket(h, num_buckets.load());
+        const auto from_source = filling(i);
+
+        // source first, it always has the lower index
+        if (from_source) {
+            locked.source = &bucket_at(source_of(i));
+            locked.source_lock = std::unique_lock<Lock>(locked.source->mutex);
+        }
+        locked.bucket = &bucket_at(i);
+        locked.bucket_lock = std::unique_lock<Lock>(locked.bucket->mutex);
+
+        // a split or merge of this bucket may have moved h while we waited, both hold the
+        // lock to publish. A merge and re-split can also swap the bucket under the same index
+        if (hash2bucket(h, num_buckets.load()) == i && filling(i) == from_source &&
+            &bucket_at(i) == locked.bucket) {
+            return;
+        }
+        locked = Locked{};
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+bool LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::matches(const Entry& entry, const K& key, size_t h) const {
+    if constexpr (cache_hashes) {
+        if (entry.hash.value != h) {
+            return false;
+        }
+    }
+    return equal_fn(entry.key, key);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+size_t LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::hash_of(const Entry& entry) const {
+    if constexpr (cache_hashes) {
+        return entry.hash.value;
+    } else {
+        return hash_fn(entry.key);
+    }
 }
 
-template <typename K, typename V>
-void LinearHash<K, V>::insert(const K& key, const V& val) {
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+bool LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::update_entry(Bucket& bucket, const K& key, size_t h, const V& val) {
+    auto& current = *bucket.entries.load();
+
+    for (size_t i = 0; i < current.size(); ++i) {
+        if (matches(current[i], key, h)) {
+            if constexpr (optimistic) {
+                if (!versioning()) {    // snapshots need the old version intact
+                    begin_write(bucket);
+                    current.overwrite(i, val);
+                    end_write(bucket);
+                    return true;
+                }
+            }
+            auto next = Entries::make(current, current.size());
+            (*next)[i].value = val;
+            publish(bucket, std::move(next));
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::push_entry(Bucket& bucket, const Entry& entry) {
+    auto& current = *bucket.entries.load();
+
+    if constexpr (optimistic) {
+        if (current.size() < current.capacity() && !versioning()) {
+            begin_write(bucket);
+            current.append(entry);
+            end_write(bucket);
+            return;
+        }
+    }
+
+    // optimistic buckets double so in place appends amortise the copy
+    const auto capacity = optimistic ? std::max<size_t>(2, current.capacity() * 2) : current.size() + 1;
+    auto next = Entries::make(current, capacity);
+    next->push_back(entry);
+    publish(bucket, std::move(next));
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+bool LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::erase_entry(Bucket& bucket_struct, const K& key, size_t h) {
+    auto& current = *bucket_struct.entries.load();
+
+    for (size_t i = 0; i < current.size(); ++i) {
+        if (matches(current[i], key, h)) {
+            if constexpr (optimistic) {
+                if (!versioning()) {
+                    begin_write(bucket_struct);
+                    current.erase(i);
+                    end_write(bucket_struct);
+                    return true;
+                }
+            }
+            auto bucket = Entries::make(current, current.size());
+            bucket->remove_at(i);
+            publish(bucket_struct, std::move(bucket));
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::insert(const K& key, const V& val) {
+    collect_step();     // before our own locks, it takes bucket locks of its own
+    lh::EpochGuard guard;   // merges retire buckets we may be waiting on
     auto should_split = false;   //carries check result out of lock scope
     {   // scope lock
-        std::shared_lock<std::shared_mutex> global_read(global_mutex);
-        const size_t i = hash2bucket(key); //Only one function call
+        std::shared_lock<GlobalLock> global_read(global_mutex);
+        const auto h = hash_fn(key);
+        Locked locked;
+        lock_bucket(h, locked);
+
+        // a bucket still filling from its split source may find the key in either
+        if (update_entry(*locked.bucket, key, h, val) ||
+            (locked.source && update_entry(*locked.source, key, h, val))) {
+            return;
+        }
+
+    push_entry(*locked.bucket, Entry{key, val, h});
+    num_elem.add(1, count_slack());
+    should_split = split_cond(num_elem.approx());
+    }
+
+    const auto step = split_step.load();
+    if (step != 0 && migrating.load() != 0) {
+        migrate_step(step);  // pay off the open split before opening another
+    } else if (should_split) {
+        if (background_splits.load()) {
+            signal_split();
+        } else {
+            split();
+        }
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+template <typename Pair>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::insert_many(std::span<Pair> items) {
+    // a chunk is grouped by the bucket count it starts with and splits only after it, so
+    // one larger than the table would pile into a few buckets and scan them for duplicates
+    // quadratically. Kept to the table size, the splits owed in between grow the next one
+    for (size_t done = 0; done < items.size();) {
+        collect_step();
+        const auto chunk = std::min(items.size() - done, num_buckets.load());
+        insert_chunk(items.subspan(done, chunk));
+        done += chunk;
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+template <typename Pair>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::insert_chunk(std::span<Pair> items) {
+    constexpr auto moving = !std::is_const_v<Pair>;
+    using KeyRef = std::conditional_t<moving, K&&, const K&>;
+    using ValueRef = std::conditional_t<moving, V&&, const V&>;
+
+    struct Pending {
+        size_t hash;
+        size_t bucket;
+        size_t item;
+    };
+
+    lh::EpochGuard guard;
+    std::vector<Pending> order;
+    std::vector<size_t> rerouted;   // a split moved them between hashing and locking
+    size_t added = 0;
+    order.reserve(items.size());
+
+    {   // scope lock
+        std::shared_lock<GlobalLock> global_read(global_mutex);
+        const auto n = num_buckets.load();
+        for (size_t i = 0; i < items.size(); ++i) {
+            const auto h = hash_fn(items[i].first);
+            order.push_back(Pending{h, hash2bucket(h, n), i});
+        }
+        // stable so duplicates keep batch order inside their bucket
+        std::stable_sort(order.begin(), order.end(), [](const Pending& a, const Pending& b) {
+            return a.bucket < b.bucket;
+        });
+
+        for (auto first = order.begin(); first != order.end();) {
+            const auto last = std::find_if(first, order.end(), [&](const Pending& p) {
+                return p.bucket != first->bucket;
+            });
+
+            // keys routed to a locked bucket stay routed there until it is unlocked
+            Locked locked;
+            lock_bucket(first->hash, locked);
+            auto& bucket = *locked.bucket;
+            Entries_ptr next;   // copy on write: one copy for the whole group
+
+            for (; first != last; ++first) {
+                if (&bucket_at(hash2bucket(first->hash, num_buckets.load())) != &bucket) {
+                    rerouted.push_back(first->item);
+                    continue;
+                }
+
+                auto& item = items[first->item];
+                if constexpr (optimistic) {
+                    if (update_entry(bucket, item.first, first->hash, item.second) ||
+                        (locked.source && update_entry(*locked.source, item.first, first->hash, item.second))) {
+                        continue;
+                    }
+                    push_entry(bucket, Entry{item.first, item.second, first->hash});
+                } else {
+                    if (!next) {
+                        const auto& current = *bucket.entries.load();
+                        next = Entries::make(current, current.size() + static_cast<size_t>(last - first));
+                    }
+
+                    auto found = std::find_if(next->begin(), next->end(), [&](const Entry& entry) {
+                        return matches(entry, item.first, first->hash);
+                    });
+                    if (found != next->end()) {
+                        found->value = static_cast<ValueRef>(item.second);
+                        continue;
+                    }
+                    if (locked.source && update_entry(*locked.source, item.first, first->hash, item.second)) {
+                        continue;
+                    }
+                    next->push_back(Entry{static_cast<KeyRef>(item.first), static_cast<ValueRef>(item.second),
+                                          first->hash});
+                }
+                ++added;
+            }
+
+            if (next) {
+                publish(bucket, std::move(next));
+            }
+        }
+    }
+    const auto before = num_elem.approx();
+    num_elem.add(static_cast<ptrdiff_t>(added), count_slack());
+
+    // the batch is owed what its inserts would have done one by one, no more: replay
+    // the count each of them would have seen, early ones may still be under the load
+    const auto step = split_step.load();
+    for (size_t i = 0; i < added; ++i) {
+        if (step != 0 && migrating.load() != 0) {
+            migrate_step(step);
+        } else if (split_cond(before + i + 1)) {
+            if (background_splits.load()) {
+                signal_split();
+                break;
+            }
+            split();
+        }
+    }
+
+    for (const auto i : rerouted) {
+        insert(items[i].first, items[i].second);
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::insert_batch(std::span<const std::pair<K, V>> items) {
+    insert_many(items);
+}
 
-        auto& bucket = *table.at(i);
-        std::unique_lock<std::shared_mutex> bucket_write(bucket.mutex);
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::insert_batch_move(std::span<std::pair<K, V>> items) {
+    insert_many(items);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::split() {
+    // only the bucket being split and its new sibling are locked, every other bucket
+    // keeps serving readers and writers
+    lh::EpochGuard guard;   // publishes must finish before a snapshot waiting on us returns
+    std::shared_lock<GlobalLock> global_read(global_mutex);
+    std::lock_guard<SplitLock> split_lock(split_mutex);
+
+    const auto step = split_step.load();
+    if (migrating.load() != 0) {    // previous split still filling
+        if (step != 0) {
+            migrate(step);  // one bounded step per call
+            return;
+        }
+        migrate(max_step);
+    }
+
+    if (!split_cond(num_elem.exact())) {return;}  //check for split while thread waiting
+
+    open_split();
+    migrate(step != 0 ? step : max_step);
+}
 
-        for (auto& entry : bucket.entries) {
-            if (entry.key == key) {
-                entry.value = val;
-                return;
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::open_split() {
+    const auto n = num_buckets.load();
+    auto& original = bucket_at(source_of(n));
+    std::unique_lock<Lock> original_write(original.mutex);   // its writers re-route
+
+    // in place steps walk the source back from its end, and move into room reserved here
+    // so that no step regrows the new bucket
+    migrate_cursor = original.entries.load()->size();
+    auto* bucket = make_bucket(stamp());
+    if constexpr (optimistic) {
+        if (split_step.load() != 0 && migrate_cursor > inline_capacity) {
+            auto reserved = Entries::make(migrate_cursor, alloc);
+            reserved->ts = bucket->entries.load()->ts;
+            bucket->entries.store(reserved.release());
+        }
+    }
+
+    // order matters for lock free readers: the new bucket is reachable and marked as
+    // filling before the count routes keys to it. Older snapshots see nothing in it yet
+    append(bucket, n);
+    migrating.store(n);
+    num_buckets.store(n + 1);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+bool LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::migrate(size_t max_entries) {
+    const auto target = migrating.load();
+    if (target == 0) {
+        return true;
+    }
+
+    auto& source = bucket_at(source_of(target));
+    auto& bucket = bucket_at(target);
+    std::unique_lock<Lock> source_write(source.mutex);
+    std::unique_lock<Lock> bucket_write(bucket.mutex);
+    if (migrating.load() != target || &bucket_at(target) != &bucket) {
+        return true;    // someone else finished it
+    }
+
+    const auto higher_mask = init_size << depth_of(target);  //single bit mask of new depth
+
+    if constexpr (optimistic) {
+        // Everything from the cursor on stays in the source: it was examined, or inserted
+        // since the split opened. erase() moves the last entry down, so removes keep that
+        // true too. The bucket gains each key before the source drops it, lookups (source,
+        // then bucket) always see it somewhere
+        if (max_entries != max_step && !versioning()) {
+            auto& from = *source.entries.load();
+            auto cursor = std::min(migrate_cursor, from.size());
+            for (auto steps = std::min(max_entries, cursor); steps != 0; --steps) {
+                --cursor;
+                if (hash_of(from[cursor]) & higher_mask) {
+                    push_entry(bucket, from[cursor]);   // in place, into the room open_split reserved
+                    begin_write(source);
+                    from.erase(cursor);
+                    end_write(source);
+                }
+            }
+            migrate_cursor = cursor;
+            if (cursor == 0) {
+                migrating.store(0);
             }
+            return cursor == 0;
+        }
+    }
+
+    // copy on write moves every key at once, a bounded step would recopy both blocks anyway
+    const auto& old = *source.entries.load();
+    const auto& filled = *bucket.entries.load();
+    auto kept = Entries::make(old.size(), alloc);
+    auto moved = Entries::make(filled, filled.size() + old.size());
+    for (const auto& entry : old) {
+        if (hash_of(entry) & higher_mask) {    // new considered bit == 1
+            moved->push_back(entry);
+        } else {
+            kept->push_back(entry);
         }
+    }
 
-    bucket.entries.push_back(Entry{key, val});
-    ++num_elem;
-    should_split = split_cond();
+    // both locks stay held until the source drops the moved keys, and the bucket gains
+    // them first so lookups (source, then bucket) always see each key somewhere. Both
+    // share a stamp so a snapshot sees each key in exactly one of them
+    if (kept->size() != old.size()) {
+        const auto ts = stamp();
+        publish(bucket, std::move(moved), ts);
+        publish(source, std::move(kept), ts);
     }
+    migrating.store(0);
+    return true;
+}
 
-    if (should_split) {
-        std::unique_lock<std::shared_mutex> global_write(global_mutex);
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::migrate_step(size_t max_entries) {
+    // migrations publish and retire blocks, whole table ops like print() must exclude them
+    std::shared_lock<GlobalLock> global_read(global_mutex);
+    migrate(max_entries);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::set_incremental_split(size_t max_entries) {
+    split_step.store(max_entries);
+}
 
-        if (!split_cond()) {return;}  //check for split while thread waiting
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::merge() {
+    lh::EpochGuard guard;
+    std::shared_lock<GlobalLock> global_read(global_mutex);
+    std::lock_guard<SplitLock> split_lock(split_mutex);
 
-        table.push_back(std::make_unique<Bucket>());
-        auto& original = *table.at(split_ptr);
-        auto& new_bucket = *table.back();
+    migrate(max_step);  // an open split must finish before its bucket can go
 
-        auto higher_mask = init_size << depth;  //single bit mask of new depth
+    // unlike splits, all owed merges happen at once: removes alone would never catch up
+    while (merge_cond(num_elem.exact())) {
+        const auto last = num_buckets.load() - 1;
+        auto& buddy = bucket_at(source_of(last));
+        auto* bucket = &bucket_at(last);
+        std::unique_lock<Lock> buddy_write(buddy.mutex);
+        std::unique_lock<Lock> bucket_write(bucket->mutex);
 
-        Bucket temp;
+        const auto& kept = *buddy.entries.load();
+        const auto& moved = *bucket->entries.load();
+        auto merged = Entries::make(kept, kept.size() + moved.size());
+        for (const auto& entry : moved) {
+            merged->push_back(entry);
+        }
+
+        // the last bucket is left intact for readers still routed by the old count, their
+        // misses retry on the merge count. Its slot is not cleared for the same reason,
+        // nobody indexes past the count once it drops and a later split overwrites it
+        publish(buddy, std::move(merged));
+        merges.fetch_add(1);
+        num_buckets.store(last);
+
+        bucket_write.unlock();
+        reclaimer.retire(bucket, [](void* p) { destroy_bucket(static_cast<Bucket*>(p)); });
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::set_min_load_factor(double load_factor) {
+    if (load_factor < 0 || load_factor >= max_load_factor) {
+        throw std::invalid_argument("Min load factor must be in [0, max load factor)");
+    }
+    min_load_factor.store(load_factor);
+}
 
-        for (auto& entry : original.entries) {
-            if ((std::hash<K>{}(entry.key)) & higher_mask) {    // new considered bit == 1
-                new_bucket.entries.push_back(entry);
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::signal_split() {
+    if (!split_pending.exchange(true)) {    // only the first insert over the limit pays for a wake
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        worker_cv.notify_one();
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::split_worker_loop() {
+    std::unique_lock<std::mutex> lock(worker_mutex);
+    for (;;) {
+        worker_cv.wait(lock, [this] {
+            return worker_stop.load() || split_pending.load() || collect_pending.load();
+        });
+        if (worker_stop.load()) {
+            return;
+        }
+
+        split_pending.store(false);     // cleared first, inserts during the catch up signal again
+        lock.unlock();
+        while (!worker_stop.load()) {
+            const auto elems = num_elem.exact();
+            if (split_cond(elems)) {
+                split();
+            } else if (merge_cond(elems)) {
+                merge();
             } else {
-                temp.entries.push_back(entry);
+                break;
             }
         }
+        if (collect_pending.exchange(false)) {
+            collect_versions();
+        }
+        lock.lock();
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::start_split_worker() {
+    static_assert(!std::is_same_v<Lock, lh::NoLock>, "the split worker is a second writer, NoLock allows one");
+    std::lock_guard<std::mutex> control(worker_control);
+    if (split_worker.joinable()) {
+        return;
+    }
+
+    worker_stop.store(false);
+    const auto elems = num_elem.exact();
+    split_pending.store(split_cond(elems) || merge_cond(elems));   // pick up any lag left from before
+    split_worker = std::thread(&LinearHash::split_worker_loop, this);
+    background_splits.store(true);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::stop_split_worker() {
+    std::lock_guard<std::mutex> control(worker_control);
+    if (!split_worker.joinable()) {
+        return;
+    }
 
-        original.entries = std::move(temp.entries);
-        split_ptr++;
+    background_splits.store(false);
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        worker_stop.store(true);
+        worker_cv.notify_one();
+    }
+    split_worker.join();
+    if (collect_pending.exchange(false)) {
+        collect_next.store(0);  // a collection it never ran goes to the writers
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+size_t LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::get_split_lag() const {
+    // split_cond holds until num_elem <= max_load_factor * buckets
+    const auto needed = static_cast<size_t>(std::ceil(static_cast<double>(num_elem.exact()) / max_load_factor));
+    const auto buckets = num_buckets.load();
+    return needed > buckets ? needed - buckets : 0;
+}
 
-        if (split_ptr >= (init_size << depth)) {
-            split_ptr = 0;
-            depth++;
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+const typename LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entry* LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::scan(const Entries& entries, const K& key, size_t h) const {
+    if constexpr (tagged) {
+        const Entry* found = nullptr;
+        lh::match_tags(entries.tags(), entries.size(), lh::tag_of(h), [&](size_t i) {
+            found = matches(entries[i], key, h) ? &entries[i] : nullptr;
+            return found != nullptr;
+        });
+        return found;
+    } else {
+        for (const auto& entry : entries) {
+            if (matches(entry, key, h)) {
+                return &entry;
+            }
         }
+        return nullptr;
     }
 }
 
-template <typename K, typename V>
-std::optional<V> LinearHash<K, V>::get(const K& key) const {
-    std::shared_lock<std::shared_mutex> global_read(global_mutex);
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+std::optional<V> LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::scan_optimistic(const Bucket& bucket, const K& key, size_t h) const {
+    for (;;) {
+        const auto version = bucket.version.load(std::memory_order_acquire);
+        if (version & 1) {
+            continue;   // edit in flight
+        }
 
-    const auto& bucket = *table.at(hash2bucket(key));
-    std::shared_lock<std::shared_mutex> bucket_read(bucket.mutex);
+        std::optional<V> found;
+        const auto& entries = *bucket.entries.load();
+        for (size_t i = 0, size = entries.size(); i < size; ++i) {
+            if constexpr (cache_hashes) {
+                if (lh::detail::load_acquire(entries[i].hash.value) != h) {
+                    continue;
+                }
+            }
+            if (equal_fn(lh::detail::load_acquire(entries[i].key), key)) {
+                found = lh::detail::load_acquire(entries[i].value);
+                break;
+            }
+        }
 
-    for (const auto& entry : bucket.entries) {
-        if (entry.key == key) {
-            return entry.value;
+        // acquire loads above keep this re-read after the scan
+        if (bucket.version.load(std::memory_order_relaxed) == version) {
+            return found;
         }
     }
-    return std::nullopt;
 }
 
-template <typename K, typename V>
-void LinearHash<K, V>::print() const {
-    std::unique_lock<std::shared_mutex> global_read(global_mutex);
-    for (size_t i = 0; i < table.size(); ++i) {
-        std::cout << "Bucket " << i << ": ";
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+const typename LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Entry* LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::find(const K& key, size_t h) const {
+    auto m = merges.load();
 
-        for (const auto& entry : table[i]->entries) {
-            std::cout << "[" << entry.key << ":" << entry.value << "]";
+    for (auto n = num_buckets.load();;) {
+        const auto i = hash2bucket(h, n);
+
+        // while filling, keys move source -> bucket, so look in that order
+        if (filling(i)) {
+            if (const auto* entry = scan(bucket_at(source_of(i)), key, h)) {
+                return entry;
+            }
         }
-        std::cout << std::endl;
+        if (const auto* entry = scan(bucket_at(i), key, h)) {
+            return entry;
+        }
+
+        // a miss is only trusted if no split or merge moved the key while we scanned
+        const auto now = num_buckets.load();
+        const auto merged = merges.load();
+        if (now == n && merged == m) {
+            return nullptr;
+        }
+        n = now;
+        m = merged;
     }
 }
 
-template <typename K, typename V>
-bool LinearHash<K, V>::in(const K& key) const {
-    std::shared_lock<std::shared_mutex> global_read(global_mutex);
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+std::optional<V> LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::find_optimistic(const K& key, size_t h) const {
+    auto m = merges.load();
 
-    const auto& bucket = *table.at(hash2bucket(key));
-    std::shared_lock<std::shared_mutex> bucket_read(bucket.mutex);
+    for (auto n = num_buckets.load();;) {
+        const auto i = hash2bucket(h, n);
 
-    for (const auto& entry : bucket.entries) {
-        if (entry.key == key) {
-            return true;
+        if (filling(i)) {
+            if (auto found = scan_optimistic(bucket_at(source_of(i)), key, h)) {
+                return found;
+            }
         }
+        if (auto found = scan_optimistic(bucket_at(i), key, h)) {
+            return found;
+        }
+
+        const auto now = num_buckets.load();
+        const auto merged = merges.load();
+        if (now == n && merged == m) {
+            return std::nullopt;
+        }
+        n = now;
+        m = merged;
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+std::optional<V> LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::lookup(const K& key, size_t h) const {
+    if constexpr (optimistic) {
+        return find_optimistic(key, h);
+    } else {
+        if (const auto* entry = find(key, h)) {
+            return entry->value;
+        }
+        return std::nullopt;
     }
-    return false;
 }
 
-template <typename K, typename V>
-bool LinearHash<K, V>::remove(const K& key) {
-    std::shared_lock<std::shared_mutex> global_read(global_mutex);
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+std::optional<V> LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::get(const K& key) const {
+    lh::EpochGuard guard;   // lock free, keeps published contents alive while we copy out
+    return lookup(key, hash_fn(key));
+}
 
-    auto& bucket_struct = *table.at(hash2bucket(key));
-    std::unique_lock<std::shared_mutex> bucket_write(bucket_struct.mutex);
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::get_many(std::span<const K> keys, std::span<std::optional<V>> results) const {
+    if (keys.size() != results.size()) {
+        throw std::invalid_argument("get_many: keys and results differ in size");
+    }
 
-    auto& bucket = bucket_struct.entries;
+    lh::EpochGuard guard;
+    std::array<size_t, prefetch_window> hashes;
+    std::array<size_t, prefetch_window> indices;
 
-    // optimised vector del: std(O(n)) vs move(O(1)) + popback(O(1))
-    for (size_t i = 0; i < bucket.size(); ++i) {
-        if (bucket[i].key == key) {
-            bucket[i] = std::move(bucket.back());
-            bucket.pop_back();
-            --num_elem;
+    for (size_t base = 0; base < keys.size(); base += prefetch_window) {
+        const auto count = std::min(prefetch_window, keys.size() - base);
+        const auto n = num_buckets.load();
+
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = hash_fn(keys[base + i]);
+            indices[i] = hash2bucket(hashes[i], n);
+            lh::detail::prefetch(&slot_at(indices[i]));
+        }
+        for (size_t i = 0; i < count; ++i) {
+            lh::detail::prefetch(slot_at(indices[i]).load());
+        }
+        for (size_t i = 0; i < count; ++i) {
+            lh::detail::prefetch(bucket_at(indices[i]).entries.load());  // header and first entries
+        }
+
+        // the full lookup still revalidates, a split since n only costs it a retry
+        for (size_t i = 0; i < count; ++i) {
+            results[base + i] = lookup(keys[base + i], hashes[i]);
+        }
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+size_t LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::worker_count(size_t requested) const {
+    if (requested == 0) {
+        requested = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    const auto chunks = (num_buckets.load() + parallel_chunk - 1) / parallel_chunk;
+    return std::min(requested, chunks);    // never more workers than chunks
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+template <typename Visit>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::parallel_buckets(size_t workers, const Visit& visit) const {
+    struct alignas(64) Range {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    const auto n = num_buckets.load();
+    std::vector<Range> ranges(workers);
+    for (size_t w = 0; w < workers; ++w) {
+        ranges[w].begin = n * w / workers;
+        ranges[w].end = n * (w + 1) / workers;
+    }
+
+    // own range first, a chunk at a time from the front
+    auto take = [&](size_t w, size_t& first, size_t& last) {
+        {
+            std::lock_guard<std::mutex> lock(ranges[w].mutex);
+            auto& own = ranges[w];
+            if (own.begin < own.end) {
+                first = own.begin;
+                last = std::min(own.begin + parallel_chunk, own.end);
+                own.begin = last;
+                return true;
+            }
+        }
+
+        // then the back half of someone else's, which becomes our own to be stolen from
+        for (size_t k = 1; k < workers; ++k) {
+            auto& victim = ranges[(w + k) % workers];
+            std::unique_lock<std::mutex> victim_lock(victim.mutex);
+            if (victim.begin == victim.end) {
+                continue;
+            }
+            first = victim.begin + (victim.end - victim.begin) / 2;
+            const auto stolen_end = victim.end;
+            victim.end = first;
+            victim_lock.unlock();
+
+            last = std::min(first + parallel_chunk, stolen_end);
+            std::lock_guard<std::mutex> lock(ranges[w].mutex);
+            ranges[w].begin = last;
+            ranges[w].end = stolen_end;
             return true;
         }
+        return false;
+    };
+
+    lh::detail::run_workers(workers, [&](size_t w, const std::atomic<bool>& failed) {
+        size_t first = 0;
+        size_t last = 0;
+        while (!failed.load() && take(w, first, last)) {
+            lh::EpochGuard guard;   // merges may retire buckets under us
+            for (size_t i = first; i < last && i < num_buckets.load(); ++i) {
+                const auto& bucket = bucket_at(i);
+                std::shared_lock<Lock> bucket_read(bucket.mutex);
+                visit(w, *bucket.entries.load());
+            }
+        }
+    });
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+template <typename Fn>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::parallel_for_each(Fn fn, size_t nthreads) const {
+    parallel_buckets(worker_count(nthreads), [&](size_t, const Entries& entries) {
+        for (const auto& entry : entries) {
+            fn(entry.key, entry.value);
+        }
+    });
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+template <typename T, typename Fold, typename Combine>
+T LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::parallel_reduce(T identity, Fold fold, Combine combine, size_t nthreads) const {
+    struct alignas(64) Partial {    // own line per worker
+        T value;
+    };
+
+    const auto workers = worker_count(nthreads);
+    std::vector<Partial> partials(workers, Partial{identity});
+    parallel_buckets(workers, [&](size_t w, const Entries& entries) {
+        for (const auto& entry : entries) {
+            partials[w].value = fold(std::move(partials[w].value), entry.key, entry.value);
+        }
+    });
+
+    auto result = std::move(identity);
+    for (auto& partial : partials) {
+        result = combine(std::move(result), std::move(partial.value));
+    }
+    return result;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+auto LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::version_at(const Bucket& bucket, uint64_t ts) -> const Entries* {
+    for (const auto* version = bucket.entries.load(); version != nullptr; version = version->prev.load()) {
+        if (version->ts <= ts) {
+            return version;
+        }
+    }
+    return nullptr;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+std::optional<V> LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::find_at(const K& key, uint64_t ts) const {
+    const auto h = hash_fn(key);
+    auto i = hash2bucket(h, num_buckets.load());    // merges wait for snapshots, only splits since
+
+    // a bucket split off after ts has no version that old, its keys were in the source
+    const auto* version = version_at(bucket_at(i), ts);
+    while (version == nullptr) {
+        i = source_of(i);
+        version = version_at(bucket_at(i), ts);
+    }
+
+    // it may also have been filling at ts. A migration step publishes both with one
+    // stamp, so each key is in exactly one of the two versions
+    const std::array<const Entries*, 2> versions{
+        version, i < init_size ? nullptr : version_at(bucket_at(source_of(i)), ts)};
+    for (const auto* entries : versions) {
+        if (entries == nullptr) {
+            continue;
+        }
+        if (const auto* entry = scan(*entries, key, h)) {   // immutable while the snapshot lives
+            return entry->value;
+        }
+    }
+    return std::nullopt;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+std::optional<V> LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Snapshot::get(const K& key) const {
+    lh::EpochGuard guard;
+    return _hm->find_at(key, _ts);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+auto LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::Snapshot::visible(size_t i) const -> const Entries* {
+    // the chain above our version may be collected under us, ours lives as long as we do
+    lh::EpochGuard guard;
+    return version_at(_hm->bucket_at(i), _ts);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+auto LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::snapshot() -> Snapshot {
+    auto& domain = lh::EpochDomain::global();
+
+    // writers that started before they could see us may still edit in place or merge
+    live_snapshots.fetch_add(1);
+    domain.synchronize();
+
+    uint64_t ts;
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex);
+        ts = clock.fetch_add(1) + 1;
+        snapshots.insert(ts);
+    }
+
+    // and ones that stamped a version <= ts may not have published it yet
+    domain.synchronize();
+    return Snapshot(this, ts, num_buckets.load());
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::release_snapshot(uint64_t ts) {
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex);
+        snapshots.erase(snapshots.find(ts));
+        live_snapshots.fetch_sub(1);
+    }
+
+    if (background_splits.load()) {
+        collect_pending.store(true);
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        worker_cv.notify_one();
+    } else {
+        collect_next.store(0);  // a whole table walk is no work for a destructor
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::collect_versions() {
+    std::vector<uint64_t> live;
+    uint64_t horizon;
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex);
+        live.assign(snapshots.begin(), snapshots.end());    // ascending
+        horizon = clock.load();     // any snapshot taken after this is newer
+    }
+
+    lh::EpochGuard guard;
+    std::shared_lock<GlobalLock> global_read(global_mutex);
+    collect_range(0, num_buckets.load(), live, horizon);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::collect_range(size_t first, size_t last,
+                                                                  const std::vector<uint64_t>& live, uint64_t horizon) {
+    for (auto i = first; i < last; ++i) {
+        auto& bucket = bucket_at(i);
+        if (bucket.entries.load()->prev.load() == nullptr) {
+            continue;
+        }
+        std::unique_lock<Lock> bucket_write(bucket.mutex);
+        prune_versions(bucket, live, horizon);
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::collect_step() {
+    if (collect_next.load(std::memory_order_relaxed) >= num_buckets.load()) {
+        return;     // no pass running, the common case
+    }
+
+    std::vector<uint64_t> live;
+    uint64_t horizon;
+    {
+        // a writer already reading the list is likely stepping too, no need to queue
+        std::unique_lock<std::mutex> lock(snapshot_mutex, std::try_to_lock);
+        if (!lock) {
+            return;
+        }
+        live.assign(snapshots.begin(), snapshots.end());
+        horizon = clock.load();
+    }
+
+    lh::EpochGuard guard;
+    std::shared_lock<GlobalLock> global_read(global_mutex);
+    const auto n = num_buckets.load();
+    const auto first = collect_next.fetch_add(collect_chunk);
+    if (first < n) {
+        collect_range(first, std::min(first + collect_chunk, n), live, horizon);
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::prune_versions(Bucket& bucket, const std::vector<uint64_t>& live, uint64_t horizon) {
+    // a version is seen by the snapshots in [its ts, the next newer version's ts).
+    // Readers may be anywhere on the chain, unlinked versions keep their own links
+    auto* kept = bucket.entries.load();
+    const auto* newer = kept;
+    for (auto* version = kept->prev.load(); version != nullptr;) {
+        auto* older = version->prev.load();
+        const auto seen = std::lower_bound(live.begin(), live.end(), version->ts);
+
+        if (newer->ts > horizon || (seen != live.end() && *seen < newer->ts)) {
+            kept->prev.store(version);
+            kept = version;
+        } else {
+            retire_entries(bucket, version);
+        }
+        newer = version;
+        version = older;
+    }
+    kept->prev.store(nullptr);
+}
+
+// GCC flags the frame setup it generates for every coroutine
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+lh::Task<std::optional<V>> LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::lookup_steps(const K& key) const {
+    const auto h = hash_fn(key);
+    const auto i = hash2bucket(h, num_buckets.load());
+
+    co_await lh::Prefetch{&slot_at(i)};
+    co_await lh::Prefetch{slot_at(i).load()};
+    co_await lh::Prefetch{bucket_at(i).entries.load()};
+    co_return lookup(key, h);   // revalidates, a split since then only costs a retry
+}
+#pragma GCC diagnostic pop
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::get_interleaved(std::span<const K> keys, std::span<std::optional<V>> results,
+                                       size_t in_flight) const {
+    if (keys.size() != results.size()) {
+        throw std::invalid_argument("get_interleaved: keys and results differ in size");
+    }
+    if (in_flight == 0) {
+        throw std::invalid_argument("get_interleaved: in_flight must be positive");
+    }
+
+    lh::EpochGuard guard;   // covers every suspended lookup
+    lh::interleave(keys.size(), in_flight,
+        [&](size_t i) { return lookup_steps(keys[i]); },
+        [&](size_t i, std::optional<V> value) { results[i] = std::move(value); });
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::print() const {
+    std::unique_lock<GlobalLock> global_read(global_mutex);
+    for (size_t i = 0; i < get_table_size(); ++i) {
+        std::cout << "Bucket " << i << ": ";
+
+        for (const auto& entry : *bucket_at(i).entries.load()) {
+            std::cout << "[" << entry.key << ":" << entry.value << "]";
+        }
+        std::cout << std::endl;
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+bool LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::in(const K& key) const {
+    lh::EpochGuard guard;
+
+    const auto h = hash_fn(key);
+    if constexpr (optimistic) {
+        return find_optimistic(key, h).has_value();
+    } else {
+        return find(key, h) != nullptr;
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+bool LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>::remove(const K& key) {
+    collect_step();
+    lh::EpochGuard guard;
+    auto removed = false;
+    auto should_merge = false;
+    {
+        std::shared_lock<GlobalLock> global_read(global_mutex);
+        const auto h = hash_fn(key);
+        Locked locked;
+        lock_bucket(h, locked);
+
+        removed = erase_entry(*locked.bucket, key, h) || (locked.source && erase_entry(*locked.source, key, h));
+        if (removed) {
+            num_elem.add(-1, count_slack());
+            should_merge = merge_cond(num_elem.approx());
+        }
+    }
+
+    const auto step = split_step.load();
+    if (step != 0 && migrating.load() != 0) {
+        migrate_step(step);
+    } else if (should_merge) {
+        if (background_splits.load()) {
+            signal_split();
+        } else {
+            merge();
+        }
     }
-    return false;   //unable to find
+    return removed;   //false: unable to find
 }
 
 #endif //MVCC_LINEAR_HASHTABLE_LINEAR_HASH_H
\ No newline at end of file
@@ -0,0 +1,462 @@
+#ifndef MVCC_LINEAR_HASHTABLE_LOCK_FREE_LINEAR_HASH_H
+#define MVCC_LINEAR_HASHTABLE_LOCK_FREE_LINEAR_HASH_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+
+#include "epoch.h"
+#include "counter.h"
+#include "linear_hash.h"
+
+// Split ordered lists (Shalev & Shavit)
+// Every entry sits in one lock free sorted list, ordered by its bit reversed hash, so
+// the keys of any bucket are contiguous and each bucket is a dummy node marking where
+// its run starts. Doubling the table splits every bucket at once without moving a node:
+// bucket b + n's keys already follow b's in the list and its dummy is linked in between
+// the first time the bucket is used, after its parent's. The list is Harris/Michael
+// style, a node is marked deleted in its next pointer before it is unlinked, and
+// unlinked nodes are retired to the epoch reclaimer. No operation takes a lock.
+namespace lh::detail {
+    constexpr uint64_t reverse_bits(uint64_t x) {
+        x = (x >> 1 & 0x5555555555555555ULL) | (x & 0x5555555555555555ULL) << 1;
+        x = (x >> 2 & 0x3333333333333333ULL) | (x & 0x3333333333333333ULL) << 2;
+        x = (x >> 4 & 0x0f0f0f0f0f0f0f0fULL) | (x & 0x0f0f0f0f0f0f0f0fULL) << 4;
+        x = (x >> 8 & 0x00ff00ff00ff00ffULL) | (x & 0x00ff00ff00ff00ffULL) << 8;
+        x = (x >> 16 & 0x0000ffff0000ffffULL) | (x & 0x0000ffff0000ffffULL) << 16;
+        return x >> 32 | x << 32;
+    }
+}
+
+// Same public API as LinearHash. Hash and KeyEqual as for std::unordered_map
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class LockFreeLinearHash {
+public:
+    // Inline values are overwritten in place with one atomic store, others are boxed and
+    // an overwrite swaps the box
+    static constexpr bool inline_values = lh::detail::atomic_copyable<V>;
+
+    struct Entry {
+        const K& key;
+        V value;
+    };
+
+private:
+    static constexpr uintptr_t deleted = 1;     // mark bit in a node's next word
+
+    struct Node {
+        uint64_t order;     // split order key: even for dummies, odd for entries
+        std::atomic<uintptr_t> next{0};
+
+        explicit Node(uint64_t order) : order(order) {}
+        bool is_dummy() const { return (order & 1) == 0; }
+    };
+
+    struct DataNode : Node {
+        K key;
+        std::conditional_t<inline_values, V, std::atomic<const V*>> value;
+
+        DataNode(uint64_t order, const K& key, const V& val);
+        ~DataNode();
+
+        V load() const;
+    };
+
+    struct Window {     // where a search stopped: *prev held cur
+        std::atomic<uintptr_t>* prev = nullptr;
+        Node* cur = nullptr;
+    };
+
+    using Slot = std::atomic<Node*>;
+    static constexpr size_t num_segments = 64;    // segment s > 0 holds buckets [2^(s-1), 2^s)
+
+    Hash hash_fn;
+    KeyEqual equal_fn;
+    const double max_load_factor;
+
+    std::array<std::atomic<Slot*>, num_segments> segments{};    // allocated on first use
+    std::atomic<size_t> num_buckets;    // power of 2, only doubles
+    lh::StripedCounter num_elem;
+    lh::Reclaimer reclaimer;
+
+    static Node* to_node(uintptr_t word) { return reinterpret_cast<Node*>(word & ~deleted); }
+    static uintptr_t to_word(const Node* node) { return reinterpret_cast<uintptr_t>(node); }
+    static bool is_deleted(uintptr_t word) { return (word & deleted) != 0; }
+    static const DataNode& data(const Node* node) { return *static_cast<const DataNode*>(node); }
+    static void destroy(Node* node);
+
+    // the top hash bit is dropped so an entry's order can set the low bit
+    size_t hash_of(const K& key) const { return hash_fn(key) & (~size_t{0} >> 1); }
+    static uint64_t entry_order(size_t h) { return lh::detail::reverse_bits(h | ~(~size_t{0} >> 1)); }
+    static uint64_t dummy_order(size_t bucket) { return lh::detail::reverse_bits(bucket); }
+    static size_t parent_of(size_t bucket) { return bucket & ~(std::bit_floor(bucket)); }
+
+    Slot& slot_at(size_t bucket);
+    const Slot* find_slot(size_t bucket) const;     // nullptr until the segment exists
+    Node* bucket_head(size_t bucket);               // links the dummy in on first use
+    const Node* nearest_head(size_t bucket) const;  // readers start from an initialised ancestor
+
+    // Positions w around the node with this order (and key, for entries), unlinking
+    // marked nodes on the way. True if found
+    bool search(Node* head, uint64_t order, const K* key, Window& w);
+    const DataNode* lookup(const K& key) const;     // read only, never helps unlink
+    void retire(Node* node);
+
+    size_t count_slack() const { return num_buckets.load() >> 10; }
+    void grow_if_loaded();
+
+public:
+    class Iterator {    // walks the list in split order, not safe against concurrent removes
+    private:
+        const Node* _node;
+
+        void go2data() {    //helper to skip dummies and deleted entries
+            while (_node != nullptr && (_node->is_dummy() || is_deleted(_node->next.load()))) {
+                _node = to_node(_node->next.load());
+            }
+        }
+
+        struct Arrow {
+            Entry entry;
+            const Entry* operator->() const { return &entry; }
+        };
+
+    public:
+        using value_type = Entry;
+        using pointer = Arrow;
+        using reference = Entry;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        explicit Iterator(const Node* node) : _node(node) { go2data(); }
+
+        reference operator*() const { return Entry{data(_node).key, data(_node).load()}; }
+        pointer operator->() const { return Arrow{**this}; }
+
+        Iterator& operator++() {
+            _node = to_node(_node->next.load());
+            go2data();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        friend bool operator==(const Iterator& a, const Iterator& b) { return a._node == b._node; }
+        friend bool operator!=(const Iterator& a, const Iterator& b) { return a._node != b._node; }
+    };
+
+    explicit LockFreeLinearHash(size_t size = 2, double load_factor = 0.75, const Hash& hash = Hash(),
+                                const KeyEqual& equal = KeyEqual());
+    ~LockFreeLinearHash();
+
+    LockFreeLinearHash(const LockFreeLinearHash&) = delete;
+    LockFreeLinearHash& operator=(const LockFreeLinearHash&) = delete;
+
+    void insert(const K& key, const V& val);
+    std::optional<V> get(const K& key) const;
+    bool in(const K& key) const;
+    bool remove(const K& key);
+
+    Hash hash_function() const { return hash_fn; }
+    KeyEqual key_eq() const { return equal_fn; }
+
+    auto get_table_size() const { return num_buckets.load(); }
+    auto get_num_elem() const { return num_elem.exact(); }
+
+    Iterator begin() const { return Iterator(find_slot(0)->load()); }
+    Iterator end() const { return Iterator(nullptr); }
+};
+
+// IMPLEMENTATION===========================================
+template <typename K, typename V, typename Hash, typename KeyEqual>
+LockFreeLinearHash<K, V, Hash, KeyEqual>::DataNode::DataNode(uint64_t order, const K& key, const V& val)
+    : Node(order), key(key), value([&] {
+        if constexpr (inline_values) {
+            return val;
+        } else {
+            return new V(val);
+        }
+    }()) {}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+LockFreeLinearHash<K, V, Hash, KeyEqual>::DataNode::~DataNode() {
+    if constexpr (!inline_values) {
+        delete value.load();
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+V LockFreeLinearHash<K, V, Hash, KeyEqual>::DataNode::load() const {
+    if constexpr (inline_values) {
+        return lh::detail::load_acquire(value);
+    } else {
+        return *value.load();
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+LockFreeLinearHash<K, V, Hash, KeyEqual>::LockFreeLinearHash(size_t size, double load_factor, const Hash& hash,
+                                                             const KeyEqual& equal)
+    : hash_fn(hash), equal_fn(equal), max_load_factor(load_factor), num_buckets(size) {
+    if (size == 0 || (size & (size - 1)) != 0) {
+        throw std::invalid_argument("Initial size must be positive power of 2");
+    }
+    slot_at(0).store(new Node(dummy_order(0)));
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+LockFreeLinearHash<K, V, Hash, KeyEqual>::~LockFreeLinearHash() {
+    // every dummy and every entry not yet unlinked is still on the list
+    for (auto* node = slot_at(0).load(); node != nullptr;) {
+        auto* next = to_node(node->next.load());
+        destroy(node);
+        node = next;
+    }
+    for (auto& segment : segments) {
+        delete[] segment.load();
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+void LockFreeLinearHash<K, V, Hash, KeyEqual>::destroy(Node* node) {
+    if (node->is_dummy()) {
+        delete node;
+    } else {
+        delete static_cast<DataNode*>(node);
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+auto LockFreeLinearHash<K, V, Hash, KeyEqual>::slot_at(size_t bucket) -> Slot& {
+    const auto s = static_cast<size_t>(std::bit_width(bucket));
+    auto* segment = segments[s].load();
+    if (segment == nullptr) {   // racing threads allocate, one wins
+        const auto length = s == 0 ? size_t{1} : size_t{1} << (s - 1);
+        auto* fresh = new Slot[length]();
+        if (segments[s].compare_exchange_strong(segment, fresh)) {
+            segment = fresh;
+        } else {
+            delete[] fresh;
+        }
+    }
+    return segment[s == 0 ? 0 : bucket - std::bit_floor(bucket)];
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+auto LockFreeLinearHash<K, V, Hash, KeyEqual>::find_slot(size_t bucket) const -> const Slot* {
+    const auto s = static_cast<size_t>(std::bit_width(bucket));
+    const auto* segment = segments[s].load();
+    if (segment == nullptr) {
+        return nullptr;
+    }
+    return &segment[s == 0 ? 0 : bucket - std::bit_floor(bucket)];
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+auto LockFreeLinearHash<K, V, Hash, KeyEqual>::bucket_head(size_t bucket) -> Node* {
+    auto& slot = slot_at(bucket);
+    if (auto* head = slot.load()) {
+        return head;
+    }
+
+    // the parent's run holds this bucket's keys, so its dummy goes in from there
+    auto* parent = bucket_head(parent_of(bucket));
+    const auto order = dummy_order(bucket);
+    auto dummy = std::make_unique<Node>(order);
+
+    Node* head = nullptr;
+    for (Window w;;) {
+        if (search(parent, order, nullptr, w)) {    // another thread linked it first
+            head = w.cur;
+            break;
+        }
+        dummy->next.store(to_word(w.cur), std::memory_order_relaxed);
+        auto expected = to_word(w.cur);
+        if (w.prev->compare_exchange_strong(expected, to_word(dummy.get()))) {
+            head = dummy.release();
+            break;
+        }
+    }
+
+    Node* unset = nullptr;
+    slot.compare_exchange_strong(unset, head);  // losers publish the same dummy
+    return head;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+auto LockFreeLinearHash<K, V, Hash, KeyEqual>::nearest_head(size_t bucket) const -> const Node* {
+    for (;; bucket = parent_of(bucket)) {
+        if (const auto* slot = find_slot(bucket)) {
+            if (const auto* head = slot->load()) {
+                return head;
+            }
+        }
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+bool LockFreeLinearHash<K, V, Hash, KeyEqual>::search(Node* head, uint64_t order, const K* key, Window& w) {
+    for (;;) {  // restarts from head when a neighbour changed under us
+        auto* prev = &head->next;
+        auto* cur = to_node(prev->load());
+
+        for (;;) {
+            if (cur == nullptr) {
+                w = Window{prev, nullptr};
+                return false;
+            }
+
+            const auto next = cur->next.load();
+            if (prev->load() != to_word(cur)) {  // prev was marked or moved on
+                break;
+            }
+
+            if (is_deleted(next)) {
+                auto expected = to_word(cur);
+                if (!prev->compare_exchange_strong(expected, next & ~deleted)) {
+                    break;
+                }
+                retire(cur);
+                cur = to_node(next);
+                continue;
+            }
+
+            if (cur->order > order) {
+                w = Window{prev, cur};
+                return false;
+            }
+            // equal orders are hash collisions, the run is scanned whole
+            if (cur->order == order && (key == nullptr || equal_fn(data(cur).key, *key))) {
+                w = Window{prev, cur};
+                return true;
+            }
+
+            prev = &cur->next;
+            cur = to_node(next);
+        }
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+auto LockFreeLinearHash<K, V, Hash, KeyEqual>::lookup(const K& key) const -> const DataNode* {
+    const auto h = hash_of(key);
+    const auto order = entry_order(h);
+
+    for (auto* cur = to_node(nearest_head(h & (num_buckets.load() - 1))->next.load()); cur != nullptr;) {
+        const auto next = cur->next.load();
+        if (cur->order > order) {
+            return nullptr;
+        }
+        if (cur->order == order && equal_fn(data(cur).key, key)) {
+            return is_deleted(next) ? nullptr : &data(cur);
+        }
+        cur = to_node(next);
+    }
+    return nullptr;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+void LockFreeLinearHash<K, V, Hash, KeyEqual>::retire(Node* node) {
+    reclaimer.retire(node, [](void* p) { destroy(static_cast<Node*>(p)); });
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+void LockFreeLinearHash<K, V, Hash, KeyEqual>::grow_if_loaded() {
+    auto n = num_buckets.load();
+    const double load = static_cast<double>(num_elem.approx()) / static_cast<double>(n);
+    if (load > max_load_factor && n < (size_t{1} << (num_segments - 2))) {
+        num_buckets.compare_exchange_strong(n, n * 2);  // losers saw it double already
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+void LockFreeLinearHash<K, V, Hash, KeyEqual>::insert(const K& key, const V& val) {
+    lh::EpochGuard guard;
+    const auto h = hash_of(key);
+    const auto order = entry_order(h);
+    auto* head = bucket_head(h & (num_buckets.load() - 1));
+
+    std::unique_ptr<DataNode> node;
+    for (Window w;;) {
+        if (search(head, order, &key, w)) {
+            auto& found = static_cast<DataNode&>(*w.cur);
+            if constexpr (inline_values) {
+                lh::detail::store_release(found.value, val);
+            } else {
+                reclaimer.retire(found.value.exchange(new V(val)));
+            }
+            return;
+        }
+
+        if (!node) {
+            node = std::make_unique<DataNode>(order, key, val);
+        }
+        node->next.store(to_word(w.cur), std::memory_order_relaxed);
+        auto expected = to_word(w.cur);
+        if (w.prev->compare_exchange_strong(expected, to_word(node.get()))) {
+            node.release();
+            break;
+        }
+    }
+
+    num_elem.add(1, count_slack());
+    grow_if_loaded();
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+std::optional<V> LockFreeLinearHash<K, V, Hash, KeyEqual>::get(const K& key) const {
+    lh::EpochGuard guard;
+    if (const auto* node = lookup(key)) {
+        return node->load();
+    }
+    return std::nullopt;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+bool LockFreeLinearHash<K, V, Hash, KeyEqual>::in(const K& key) const {
+    lh::EpochGuard guard;
+    return lookup(key) != nullptr;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+bool LockFreeLinearHash<K, V, Hash, KeyEqual>::remove(const K& key) {
+    lh::EpochGuard guard;
+    const auto h = hash_of(key);
+    const auto order = entry_order(h);
+    auto* head = bucket_head(h & (num_buckets.load() - 1));
+
+    for (Window w;;) {
+        if (!search(head, order, &key, w)) {
+            return false;
+        }
+
+        // marking is the remove, whoever unlinks the node afterwards retires it
+        auto next = w.cur->next.load();
+        if (is_deleted(next) || !w.cur->next.compare_exchange_strong(next, next | deleted)) {
+            continue;
+        }
+        auto expected = to_word(w.cur);
+        if (w.prev->compare_exchange_strong(expected, next)) {
+            retire(w.cur);
+        } else {
+            search(head, order, &key, w);
+        }
+
+        num_elem.add(-1, count_slack());
+        return true;
+    }
+}
+
+#endif //MVCC_LINEAR_HASHTABLE_LOCK_FREE_LINEAR_HASH_H
@@ -0,0 +1,262 @@
+#include <catch2/catch.hpp>
+#include "lock_free_linear_hash.h"
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct CollidingHash {  // every key shares one split order
+        size_t operator()(int) const { return 7; }
+    };
+}
+
+TEST_CASE("Split order") {
+    REQUIRE(lh::detail::reverse_bits(0) == 0);
+    REQUIRE(lh::detail::reverse_bits(1) == 0x8000000000000000ULL);
+    REQUIRE(lh::detail::reverse_bits(0x8000000000000000ULL) == 1);
+    REQUIRE(lh::detail::reverse_bits(0x00000000000000f0ULL) == 0x0f00000000000000ULL);
+    REQUIRE(lh::detail::reverse_bits(lh::detail::reverse_bits(0x0123456789abcdefULL)) == 0x0123456789abcdefULL);
+}
+
+TEST_CASE("Lock free basic operations") {
+    LockFreeLinearHash<int, int> map(2, 0.75);
+
+    SECTION("Initialization") {
+        REQUIRE(map.get_num_elem() == 0);
+        REQUIRE(map.get_table_size() == 2);
+        REQUIRE(map.begin() == map.end());
+    }
+
+    SECTION("Insert, get, overwrite") {
+        map.insert(1, 100);
+        map.insert(2, 200);
+        map.insert(1, 999);
+
+        REQUIRE(map.get_num_elem() == 2);
+        REQUIRE(map.get(1).value() == 999);
+        REQUIRE(map.get(2).value() == 200);
+        REQUIRE_FALSE(map.get(3).has_value());
+    }
+
+    SECTION("Remove") {
+        map.insert(1, 100);
+        map.insert(2, 200);
+
+        REQUIRE(map.remove(1));
+        REQUIRE_FALSE(map.remove(1));
+        REQUIRE_FALSE(map.in(1));
+        REQUIRE(map.in(2));
+        REQUIRE(map.get_num_elem() == 1);
+    }
+
+    SECTION("Constructor throws") {
+        using LockFreeType = LockFreeLinearHash<int, int>;
+        REQUIRE_THROWS_AS(LockFreeType(0), std::invalid_argument);
+        REQUIRE_THROWS_AS(LockFreeType(3), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Lock free resize") {
+    LockFreeLinearHash<int, int> map(2, 0.5);
+
+    // the table doubles, every bucket splits at once
+    map.insert(1, 1);
+    REQUIRE(map.get_table_size() == 2);
+    map.insert(2, 2);
+    REQUIRE(map.get_table_size() == 4);
+
+    for (int i = 0; i < 1000; ++i) {
+        map.insert(i, i * 10);
+    }
+    REQUIRE(map.get_num_elem() == 1000);
+    REQUIRE(map.get_table_size() >= 2048);
+    for (int i = 0; i < 1000; ++i) {
+        REQUIRE(map.get(i).value() == i * 10);
+    }
+}
+
+TEST_CASE("Lock free complex types") {
+    LockFreeLinearHash<std::string, std::string> map(2, 0.8);
+    REQUIRE_FALSE(map.inline_values);
+
+    for (int i = 0; i < 200; ++i) {
+        map.insert("key" + std::to_string(i), "val" + std::to_string(i));
+    }
+    map.insert("key10", "changed");
+    map.insert("", "empty");
+
+    REQUIRE(map.get_num_elem() == 201);
+    REQUIRE(map.get("key10").value() == "changed");
+    REQUIRE(map.get("key199").value() == "val199");
+    REQUIRE(map.get("").value() == "empty");
+
+    REQUIRE(map.remove("key10"));
+    REQUIRE_FALSE(map.in("key10"));
+}
+
+TEST_CASE("Lock free colliding hashes") {
+    LockFreeLinearHash<int, int, CollidingHash> map(2, 0.75);
+
+    for (int i = 0; i < 100; ++i) {
+        map.insert(i, i);
+    }
+    REQUIRE(map.get_num_elem() == 100);
+
+    for (int i = 0; i < 100; i += 2) {
+        REQUIRE(map.remove(i));
+    }
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(map.in(i) == (i % 2 == 1));
+    }
+}
+
+TEST_CASE("Lock free iterator") {
+    LockFreeLinearHash<int, int> map(4, 0.75);
+    for (int i = 0; i < 500; ++i) {
+        map.insert(i, i * 2);
+    }
+    for (int i = 0; i < 500; i += 5) {
+        map.remove(i);
+    }
+
+    std::set<int> seen;
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        REQUIRE(it->value == it->key * 2);
+        REQUIRE(seen.insert(it->key).second);
+    }
+    REQUIRE(seen.size() == 400);
+    REQUIRE(seen.count(5) == 0);
+}
+
+TEST_CASE("Lock free concurrency") {
+    SECTION("Parallel inserts") {
+        const int NUM_THREADS = 8;
+        const int ITEMS_PER_THREAD = 5000;
+        LockFreeLinearHash<int, int> map(2, 0.75);
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < NUM_THREADS; ++t) {
+            threads.emplace_back([&map, t]() {
+                for (int i = 0; i < ITEMS_PER_THREAD; ++i) {
+                    map.insert((t * 1000000) + i, i);
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+
+        REQUIRE(map.get_num_elem() == NUM_THREADS * ITEMS_PER_THREAD);
+        for (int t = 0; t < NUM_THREADS; ++t) {
+            REQUIRE(map.get(t * 1000000 + ITEMS_PER_THREAD - 1).value() == ITEMS_PER_THREAD - 1);
+        }
+    }
+
+    SECTION("Readers never miss during growth") {
+        LockFreeLinearHash<int, int> map(2, 0.75);
+        for (int i = 0; i < 1000; ++i) map.insert(i, i);
+
+        std::atomic<bool> running{true};
+        std::atomic<int> read_errors{0};
+        std::vector<std::thread> threads;
+
+        for (int r = 0; r < 4; ++r) {
+            threads.emplace_back([&, r]() {
+                for (int i = r; running; i = (i + 7) % 1000) {
+                    auto res = map.get(i);
+                    if (!res.has_value() || res.value() != i) {
+                        ++read_errors;
+                    }
+                }
+            });
+        }
+        for (int w = 0; w < 4; ++w) {
+            threads.emplace_back([&, w]() {
+                for (int j = 0; j < 2000; ++j) {
+                    map.insert(10000 + (w * 10000) + j, j);
+                }
+            });
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        running = false;
+        for (auto& t : threads) t.join();
+
+        REQUIRE(read_errors == 0);
+        REQUIRE(map.get_num_elem() == 1000 + (4 * 2000));
+    }
+
+    SECTION("Insert and remove churn") {
+        LockFreeLinearHash<std::string, int> map(4, 0.75);
+        std::vector<std::thread> threads;
+
+        // each thread owns its keys, so the final contents are known
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&map, t]() {
+                for (int round = 0; round < 5; ++round) {
+                    for (int i = 0; i < 500; ++i) {
+                        map.insert(std::to_string(t) + ":" + std::to_string(i), round);
+                    }
+                    for (int i = 0; i < 500; i += 2) {
+                        map.remove(std::to_string(t) + ":" + std::to_string(i));
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+
+        REQUIRE(map.get_num_elem() == 4 * 250);
+        REQUIRE(map.get("3:499").value() == 4);
+        REQUIRE_FALSE(map.in("3:498"));
+    }
+
+    SECTION("Concurrent overwrite one key") {
+        LockFreeLinearHash<int, std::string> map(2, 0.75);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; ++t) {
+            threads.emplace_back([&map, t]() {
+                for (int i = 0; i < 2000; ++i) {
+                    map.insert(0, std::string(32, static_cast<char>('a' + t)));
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+
+        REQUIRE(map.get_num_elem() == 1);
+        REQUIRE(map.get(0).value().size() == 32);
+    }
+}
+
+// The same workloads against both engines, compare with --durations yes
+TEMPLATE_TEST_CASE("Engines head to head", "[engines]", (LinearHash<int, int>), (LockFreeLinearHash<int, int>)) {
+    const int NUM_THREADS = 4;
+    const int ITEMS_PER_THREAD = 20000;
+    TestType map(2, 0.75);
+    std::atomic<int> lost{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NUM_THREADS; ++t) {
+        threads.emplace_back([&map, &lost, t]() {
+            const int base = t * 1000000;
+            for (int i = 0; i < ITEMS_PER_THREAD; ++i) {
+                map.insert(base + i, i);
+            }
+            for (int i = 0; i < ITEMS_PER_THREAD; ++i) {
+                if (map.get(base + i) != i) {
+                    ++lost;
+                }
+            }
+            for (int i = 0; i < ITEMS_PER_THREAD; i += 2) {
+                map.remove(base + i);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    REQUIRE(lost == 0);
+    REQUIRE(map.get_num_elem() == NUM_THREADS * ITEMS_PER_THREAD / 2);
+    REQUIRE(map.in(1));
+    REQUIRE_FALSE(map.in(0));
+}
@@ -0,0 +1,509 @@
+#ifndef MVCC_LINEAR_HASHTABLE_LOCKS_H
+#define MVCC_LINEAR_HASHTABLE_LOCKS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "epoch.h"
+
+// Compact locks
+// Drop in SharedLockable replacements for std::shared_mutex, sized to sit in a bucket's
+// header rather than next to it. Any of them, or std::shared_mutex, is a LinearHash lock
+// policy. The exclusive only ones take shared locks exclusively.
+namespace lh {
+
+namespace detail {
+    inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    // spins a while, then yields so a preempted holder gets the core back
+    class Backoff {
+    public:
+        void pause() {
+            if (spins < spin_limit) {
+                ++spins;
+                cpu_relax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+    private:
+        static constexpr int spin_limit = 64;
+        int spins = 0;
+    };
+}
+
+// Reader-writer lock in one 32 bit word. Spins briefly, then parks on the word itself
+// (std::atomic::wait, a futex on Linux). Writers get preference: once one is waiting no
+// new readers enter. Only unlocks that find a parked waiter pay for a wake
+class SharedFutex {
+public:
+    SharedFutex() = default;
+
+    SharedFutex(const SharedFutex&) = delete;
+    SharedFutex& operator=(const SharedFutex&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+
+private:
+    static constexpr uint32_t writer = 1u << 31;
+    static constexpr uint32_t writer_waiting = 1u << 30;
+    static constexpr uint32_t parked = 1u << 29;
+    static constexpr uint32_t readers = parked - 1;     // count in the low bits
+    static constexpr int spin_limit = 64;
+
+    std::atomic<uint32_t> state{0};
+
+    void wait(uint32_t seen, int& spins);     // spins, then parks while state == seen | parked
+    void wake(uint32_t seen);
+};
+
+static_assert(sizeof(SharedFutex) == 4);
+
+// Test and test and set. One byte, waiters spin on a plain load so only the releasing
+// store bounces the line
+class SpinLock {
+public:
+    SpinLock() = default;
+
+    SpinLock(const SpinLock&) = delete;
+    SpinLock& operator=(const SpinLock&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock() { locked.store(false, std::memory_order_release); }
+
+    void lock_shared() { lock(); }
+    bool try_lock_shared() { return try_lock(); }
+    void unlock_shared() { unlock(); }
+
+private:
+    std::atomic<bool> locked{false};
+};
+
+// FIFO spin lock, two 16 bit counters
+class TicketLock {
+public:
+    TicketLock() = default;
+
+    TicketLock(const TicketLock&) = delete;
+    TicketLock& operator=(const TicketLock&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    void lock_shared() { lock(); }
+    bool try_lock_shared() { return try_lock(); }
+    void unlock_shared() { unlock(); }
+
+private:
+    std::atomic<uint16_t> next{0};
+    std::atomic<uint16_t> serving{0};
+};
+
+// Single threaded writers: locking compiles away. Lock free reads stay safe alongside
+// the one writer, concurrent writers do not, so a LinearHash refuses to compile its
+// background split worker with it
+struct NoLock {
+    void lock() {}
+    bool try_lock() { return true; }
+    void unlock() {}
+
+    void lock_shared() {}
+    bool try_lock_shared() { return true; }
+    void unlock_shared() {}
+};
+
+// Reader biased wrapper (BRAVO). While the bias is on, a reader announces itself in its
+// thread's row of a shared visible readers table, in the column this lock hashes to,
+// and never touches the lock word. A writer turns the bias off, waits for that column
+// to drain, and keeps the bias off for a multiple of the time it waited so a write
+// heavy phase does not pay for revocation over and over. Readers fall back to
+// Underlying whenever their slot is taken or the bias is off
+template <typename Underlying = SharedFutex>
+class BravoLock {
+public:
+    BravoLock() = default;
+
+    BravoLock(const BravoLock&) = delete;
+    BravoLock& operator=(const BravoLock&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock() { underlying.unlock(); }
+
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+
+private:
+    using Slot = std::atomic<const void*>;
+    static constexpr size_t rows = 64;      // threads past this always take the slow path
+    static constexpr size_t columns = 64;
+    static constexpr int64_t inhibit_factor = 9;
+
+    struct alignas(64) Row {
+        std::array<Slot, columns> slots{};
+    };
+
+    Underlying underlying;
+    std::atomic<bool> bias{true};
+    std::atomic<int64_t> inhibit_until{0};  // steady clock ns, no bias before then
+
+    static std::array<Row, rows>& visible_readers() {
+        static std::array<Row, rows> table;
+        return table;
+    }
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    size_t column() const;
+    Slot* slot() const;     // this thread's slot for this lock, nullptr past the rows
+    bool try_fast_shared(); // true: announced while the bias is on
+    bool revoke(bool wait); // bias off, true once no fast reader remains. Caller holds underlying
+};
+
+// Reader indicator striped by thread: a reader only writes its own stripe's cache line,
+// so shared locking scales with cores. A writer raises its flag and waits for every
+// stripe to drain, readers that see the flag back out until it drops. Meant for locks
+// nearly always taken shared, writers pay a scan of all stripes
+class StripedSharedMutex {
+public:
+    StripedSharedMutex() = default;
+
+    StripedSharedMutex(const StripedSharedMutex&) = delete;
+    StripedSharedMutex& operator=(const StripedSharedMutex&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<size_t> readers{0};
+    };
+
+    static constexpr size_t num_stripes = 32;
+
+    SharedFutex writers;    // one writer at a time, held exclusively
+    std::atomic<bool> writing{false};
+    std::array<Stripe, num_stripes> stripes;
+
+    static size_t stripe_index() { return EpochDomain::global().local().index % num_stripes; }
+    bool drained() const;
+};
+
+template <typename Lock>
+inline constexpr bool is_reader_biased = false;
+template <typename Underlying>
+inline constexpr bool is_reader_biased<BravoLock<Underlying>> = true;
+
+// IMPLEMENTATION===========================================
+inline void SharedFutex::wait(uint32_t seen, int& spins) {
+    if (spins < spin_limit) {
+        ++spins;
+        detail::cpu_relax();
+        return;
+    }
+    if (!(seen & parked) && !state.compare_exchange_weak(seen, seen | parked, std::memory_order_relaxed)) {
+        return;     // moved on, the caller takes another look
+    }
+    state.wait(seen | parked, std::memory_order_relaxed);
+}
+
+inline void SharedFutex::wake(uint32_t seen) {
+    if (seen & parked) {
+        // waiters recheck and park again if they still cannot go
+        state.fetch_and(~parked, std::memory_order_relaxed);
+        state.notify_all();
+    }
+}
+
+inline void SharedFutex::lock() {
+    for (auto spins = 0;;) {
+        auto s = state.load(std::memory_order_relaxed);
+        if ((s & (writer | readers)) == 0) {
+            // other waiting writers put their mark back on their next look
+            if (state.compare_exchange_weak(s, (s & parked) | writer, std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+                return;
+            }
+            continue;
+        }
+        if (!(s & writer_waiting)) {    // hold off new readers
+            if (!state.compare_exchange_weak(s, s | writer_waiting, std::memory_order_relaxed)) {
+                continue;
+            }
+            s |= writer_waiting;
+        }
+        wait(s, spins);
+    }
+}
+
+inline bool SharedFutex::try_lock() {
+    auto s = state.load(std::memory_order_relaxed);
+    return (s & (writer | readers)) == 0 &&
+           state.compare_exchange_strong(s, (s & parked) | writer, std::memory_order_acquire,
+                                         std::memory_order_relaxed);
+}
+
+inline void SharedFutex::unlock() {
+    // no readers got in while we held it, only marks can be left
+    wake(state.exchange(0, std::memory_order_release));
+}
+
+inline void SharedFutex::lock_shared() {
+    for (auto spins = 0;;) {
+        auto s = state.load(std::memory_order_relaxed);
+        if (!(s & (writer | writer_waiting))) {
+            if (state.compare_exchange_weak(s, s + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return;
+            }
+            continue;
+        }
+        wait(s, spins);
+    }
+}
+
+inline bool SharedFutex::try_lock_shared() {
+    auto s = state.load(std::memory_order_relaxed);
+    while (!(s & (writer | writer_waiting))) {
+        if (state.compare_exchange_weak(s, s + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void SharedFutex::unlock_shared() {
+    const auto s = state.fetch_sub(1, std::memory_order_release) - 1;
+    if ((s & readers) == 0) {   // last one out lets a writer in
+        wake(s);
+    }
+}
+
+inline void SpinLock::lock() {
+    detail::Backoff backoff;
+    while (locked.exchange(true, std::memory_order_acquire)) {
+        while (locked.load(std::memory_order_relaxed)) {
+            backoff.pause();
+        }
+    }
+}
+
+inline bool SpinLock::try_lock() {
+    return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+}
+
+inline void TicketLock::lock() {
+    const auto ticket = next.fetch_add(1, std::memory_order_relaxed);
+    detail::Backoff backoff;
+    while (serving.load(std::memory_order_acquire) != ticket) {
+        backoff.pause();
+    }
+}
+
+inline bool TicketLock::try_lock() {
+    // serving never passes next, so taking the next ticket while they match means ours is up
+    auto ticket = serving.load(std::memory_order_acquire);
+    return next.compare_exchange_strong(ticket, static_cast<uint16_t>(ticket + 1), std::memory_order_acquire,
+                                        std::memory_order_relaxed);
+}
+
+inline void TicketLock::unlock() {
+    // only the holder writes serving
+    serving.store(static_cast<uint16_t>(serving.load(std::memory_order_relaxed) + 1), std::memory_order_release);
+}
+
+inline bool StripedSharedMutex::drained() const {
+    for (const auto& stripe : stripes) {
+        if (stripe.readers.load() != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline void StripedSharedMutex::lock() {
+    writers.lock();
+    writing.store(true);    // seq_cst against the readers' increment, one of us sees the other
+
+    detail::Backoff backoff;
+    while (!drained()) {
+        backoff.pause();
+    }
+}
+
+inline bool StripedSharedMutex::try_lock() {
+    if (!writers.try_lock()) {
+        return false;
+    }
+    writing.store(true);
+    if (!drained()) {
+        writing.store(false, std::memory_order_release);
+        writers.unlock();
+        return false;
+    }
+    return true;
+}
+
+inline void StripedSharedMutex::unlock() {
+    writing.store(false, std::memory_order_release);
+    writers.unlock();
+}
+
+inline void StripedSharedMutex::lock_shared() {
+    auto& stripe = stripes[stripe_index()];
+    for (;;) {
+        stripe.readers.fetch_add(1);
+        if (!writing.load()) {
+            return;
+        }
+
+        // back out so the writer can drain, then wait for it to finish
+        stripe.readers.fetch_sub(1, std::memory_order_release);
+        detail::Backoff backoff;
+        while (writing.load(std::memory_order_acquire)) {
+            backoff.pause();
+        }
+    }
+}
+
+inline bool StripedSharedMutex::try_lock_shared() {
+    auto& stripe = stripes[stripe_index()];
+    stripe.readers.fetch_add(1);
+    if (!writing.load()) {
+        return true;
+    }
+    stripe.readers.fetch_sub(1, std::memory_order_release);
+    return false;
+}
+
+inline void StripedSharedMutex::unlock_shared() {
+    stripes[stripe_index()].readers.fetch_sub(1, std::memory_order_release);
+}
+
+template <typename Underlying>
+size_t BravoLock<Underlying>::column() const {
+    const auto h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this)) * 0x9e3779b97f4a7c15ULL;
+    return static_cast<size_t>(h >> 58) % columns;
+}
+
+template <typename Underlying>
+auto BravoLock<Underlying>::slot() const -> Slot* {
+    const auto row = EpochDomain::global().local().index;
+    return row < rows ? &visible_readers()[row].slots[column()] : nullptr;
+}
+
+template <typename Underlying>
+bool BravoLock<Underlying>::try_fast_shared() {
+    if (!bias.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    auto* mine = slot();
+    const void* empty = nullptr;
+    if (mine == nullptr || !mine->compare_exchange_strong(empty, this)) {
+        return false;   // another lock of ours shares the column
+    }
+
+    // seq_cst on both sides: either the writer sees our slot or we see its revocation
+    if (bias.load()) {
+        return true;
+    }
+    mine->store(nullptr);
+    return false;
+}
+
+template <typename Underlying>
+void BravoLock<Underlying>::lock_shared() {
+    if (try_fast_shared()) {
+        return;
+    }
+    underlying.lock_shared();
+    if (!bias.load(std::memory_order_relaxed) && now() >= inhibit_until.load(std::memory_order_relaxed)) {
+        bias.store(true);
+    }
+}
+
+template <typename Underlying>
+bool BravoLock<Underlying>::try_lock_shared() {
+    return try_fast_shared() || underlying.try_lock_shared();
+}
+
+template <typename Underlying>
+void BravoLock<Underlying>::unlock_shared() {
+    // a slot holding this lock is ours, only our thread writes our row. Nested shared
+    // holds of one lock pair up either way
+    auto* mine = slot();
+    if (mine != nullptr && mine->load(std::memory_order_relaxed) == this) {
+        mine->store(nullptr, std::memory_order_release);
+        return;
+    }
+    underlying.unlock_shared();
+}
+
+template <typename Underlying>
+bool BravoLock<Underlying>::revoke(bool wait) {
+    if (!bias.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    bias.store(false);
+
+    const auto start = now();
+    const auto col = column();
+    for (auto& row : visible_readers()) {
+        detail::Backoff backoff;
+        while (row.slots[col].load() == this) {
+            if (!wait) {
+                bias.store(true);   // bias off must mean no fast readers
+                return false;
+            }
+            backoff.pause();
+        }
+    }
+    const auto end = now();
+    inhibit_until.store(end + (end - start) * inhibit_factor, std::memory_order_relaxed);
+    return true;
+}
+
+template <typename Underlying>
+void BravoLock<Underlying>::lock() {
+    underlying.lock();
+    revoke(true);
+}
+
+template <typename Underlying>
+bool BravoLock<Underlying>::try_lock() {
+    if (!underlying.try_lock()) {
+        return false;
+    }
+    if (!revoke(false)) {
+        underlying.unlock();
+        return false;
+    }
+    return true;
+}
+
+} // namespace lh
+
+#endif //MVCC_LINEAR_HASHTABLE_LOCKS_H
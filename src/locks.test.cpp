@@ -0,0 +1,317 @@
+#include <catch2/catch.hpp>
+#include "locks.h"
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Shared futex") {
+    SECTION("Fits in a word") {
+        REQUIRE(sizeof(lh::SharedFutex) == 4);
+    }
+
+    SECTION("Readers share, writers exclude") {
+        lh::SharedFutex mutex;
+        mutex.lock_shared();
+        REQUIRE(mutex.try_lock_shared());
+        REQUIRE_FALSE(mutex.try_lock());
+        mutex.unlock_shared();
+        mutex.unlock_shared();
+
+        REQUIRE(mutex.try_lock());
+        REQUIRE_FALSE(mutex.try_lock_shared());
+        REQUIRE_FALSE(mutex.try_lock());
+        mutex.unlock();
+        REQUIRE(mutex.try_lock_shared());
+        mutex.unlock_shared();
+    }
+
+    SECTION("A waiting writer holds off new readers") {
+        lh::SharedFutex mutex;
+        mutex.lock_shared();
+
+        std::atomic<bool> written{false};
+        std::thread writer([&]() {
+            std::unique_lock<lh::SharedFutex> lock(mutex);
+            written = true;
+        });
+
+        while (mutex.try_lock_shared()) {   // until the writer has announced itself
+            mutex.unlock_shared();
+            std::this_thread::yield();
+        }
+        REQUIRE_FALSE(written);
+        mutex.unlock_shared();
+        writer.join();
+        REQUIRE(written);
+    }
+
+    SECTION("Parked waiters are woken") {
+        lh::SharedFutex mutex;
+        mutex.lock();
+
+        std::atomic<int> entered{0};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&, i]() {
+                if (i % 2 == 0) {
+                    std::shared_lock<lh::SharedFutex> lock(mutex);
+                    ++entered;
+                } else {
+                    std::unique_lock<lh::SharedFutex> lock(mutex);
+                    ++entered;
+                }
+            });
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));     // long past the spin
+        REQUIRE(entered == 0);
+        mutex.unlock();
+        for (auto& t : threads) t.join();
+        REQUIRE(entered == 4);
+    }
+
+    SECTION("Mixed contention keeps writers exclusive") {
+        lh::SharedFutex mutex;
+        long counter = 0;
+        std::atomic<int> torn{0};
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&]() {
+                for (int n = 0; n < 20000; ++n) {
+                    std::unique_lock<lh::SharedFutex> lock(mutex);
+                    counter += 2;
+                }
+            });
+            threads.emplace_back([&]() {
+                for (int n = 0; n < 20000; ++n) {
+                    std::shared_lock<lh::SharedFutex> lock(mutex);
+                    if (counter % 2 != 0) ++torn;
+                }
+            });
+        }
+
+        for (auto& t : threads) t.join();
+        REQUIRE(counter == 4 * 20000 * 2);
+        REQUIRE(torn == 0);
+    }
+}
+
+namespace {
+    template <typename Lock>
+    void check_exclusive() {
+        Lock mutex;
+        REQUIRE(mutex.try_lock());
+        REQUIRE_FALSE(mutex.try_lock());
+        REQUIRE_FALSE(mutex.try_lock_shared());     // shared is exclusive too
+        mutex.unlock();
+
+        long counter = 0;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&]() {
+                for (int n = 0; n < 20000; ++n) {
+                    if (n % 2 == 0) {
+                        std::unique_lock<Lock> lock(mutex);
+                        ++counter;
+                    } else {
+                        std::shared_lock<Lock> lock(mutex);
+                        ++counter;
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+        REQUIRE(counter == 4 * 20000);
+    }
+}
+
+TEST_CASE("Spin locks") {
+    SECTION("Test and test and set") {
+        REQUIRE(sizeof(lh::SpinLock) == 1);
+        check_exclusive<lh::SpinLock>();
+    }
+
+    SECTION("Ticket") {
+        REQUIRE(sizeof(lh::TicketLock) == 4);
+        check_exclusive<lh::TicketLock>();
+    }
+
+    SECTION("Tickets are served in order") {
+        lh::TicketLock mutex;
+        mutex.lock();
+
+        std::vector<int> order;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 3; ++i) {
+            threads.emplace_back([&, i]() {
+                std::lock_guard<lh::TicketLock> lock(mutex);
+                order.push_back(i);
+            });
+            // each takes its ticket before the next starts
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+
+        mutex.unlock();
+        for (auto& t : threads) t.join();
+        REQUIRE(order == std::vector<int>{0, 1, 2});
+    }
+
+    SECTION("No lock") {
+        lh::NoLock mutex;
+        std::unique_lock<lh::NoLock> lock(mutex);
+        REQUIRE(lock.owns_lock());
+        REQUIRE(mutex.try_lock_shared());
+    }
+}
+
+TEST_CASE("Reader biased lock") {
+    SECTION("Fast readers never touch the underlying lock") {
+        lh::BravoLock<lh::SharedFutex> mutex;
+        mutex.lock_shared();
+        mutex.lock_shared();    // nested: the second takes the slow path
+        mutex.unlock_shared();
+        mutex.unlock_shared();
+
+        REQUIRE(mutex.try_lock());
+        REQUIRE_FALSE(mutex.try_lock_shared());
+        mutex.unlock();
+    }
+
+    SECTION("A writer waits for announced readers") {
+        lh::BravoLock<> mutex;
+        mutex.lock_shared();
+        REQUIRE_FALSE(mutex.try_lock());    // revokes the bias, but a reader is still visible
+
+        std::atomic<bool> written{false};
+        std::thread writer([&]() {
+            std::unique_lock<lh::BravoLock<>> lock(mutex);
+            written = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        REQUIRE_FALSE(written);
+        mutex.unlock_shared();
+        writer.join();
+        REQUIRE(written);
+    }
+
+    SECTION("Slow readers restore the bias once the writer's inhibit runs out") {
+        lh::BravoLock<std::shared_mutex> mutex;
+        mutex.lock();
+        mutex.unlock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        mutex.lock_shared();    // slow, turns the bias back on
+        mutex.unlock_shared();
+        mutex.lock_shared();    // fast
+        REQUIRE_FALSE(mutex.try_lock());
+        mutex.unlock_shared();
+        REQUIRE(mutex.try_lock());
+        mutex.unlock();
+    }
+
+    SECTION("Mixed contention keeps writers exclusive") {
+        lh::BravoLock<> mutex;
+        long counter = 0;
+        std::atomic<int> torn{0};
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < 2; ++i) {
+            threads.emplace_back([&]() {
+                for (int n = 0; n < 5000; ++n) {
+                    std::unique_lock<lh::BravoLock<>> lock(mutex);
+                    ++counter;
+                    ++counter;
+                }
+            });
+        }
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&]() {
+                for (int n = 0; n < 20000; ++n) {
+                    std::shared_lock<lh::BravoLock<>> lock(mutex);
+                    if (counter % 2 != 0) ++torn;
+                }
+            });
+        }
+
+        for (auto& t : threads) t.join();
+        REQUIRE(counter == 2 * 5000 * 2);
+        REQUIRE(torn == 0);
+    }
+}
+
+TEST_CASE("Striped shared mutex") {
+    SECTION("Readers share, writers exclude") {
+        lh::StripedSharedMutex mutex;
+        mutex.lock_shared();
+        REQUIRE(mutex.try_lock_shared());
+        REQUIRE_FALSE(mutex.try_lock());
+        mutex.unlock_shared();
+        mutex.unlock_shared();
+
+        REQUIRE(mutex.try_lock());
+        REQUIRE_FALSE(mutex.try_lock_shared());
+        REQUIRE_FALSE(mutex.try_lock());
+        mutex.unlock();
+        REQUIRE(mutex.try_lock_shared());
+        mutex.unlock_shared();
+    }
+
+    SECTION("Readers on other threads hold off a writer") {
+        lh::StripedSharedMutex mutex;
+        std::atomic<bool> reading{false};
+        std::atomic<bool> release{false};
+        std::thread reader([&]() {
+            std::shared_lock<lh::StripedSharedMutex> lock(mutex);
+            reading = true;
+            while (!release) std::this_thread::yield();
+        });
+        while (!reading) std::this_thread::yield();
+
+        REQUIRE_FALSE(mutex.try_lock());
+        std::atomic<bool> written{false};
+        std::thread writer([&]() {
+            std::unique_lock<lh::StripedSharedMutex> lock(mutex);
+            written = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        REQUIRE_FALSE(written);
+
+        release = true;
+        reader.join();
+        writer.join();
+        REQUIRE(written);
+    }
+
+    SECTION("Mixed contention keeps writers exclusive") {
+        lh::StripedSharedMutex mutex;
+        long counter = 0;
+        std::atomic<int> torn{0};
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < 2; ++i) {
+            threads.emplace_back([&]() {
+                for (int n = 0; n < 2000; ++n) {
+                    std::unique_lock<lh::StripedSharedMutex> lock(mutex);
+                    ++counter;
+                    ++counter;
+                }
+            });
+        }
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&]() {
+                for (int n = 0; n < 20000; ++n) {
+                    std::shared_lock<lh::StripedSharedMutex> lock(mutex);
+                    if (counter % 2 != 0) ++torn;
+                }
+            });
+        }
+
+        for (auto& t : threads) t.join();
+        REQUIRE(counter == 2 * 2000 * 2);
+        REQUIRE(torn == 0);
+    }
+}
@@ -0,0 +1,231 @@
+#ifndef MVCC_LINEAR_HASHTABLE_NUMA_H
+#define MVCC_LINEAR_HASHTABLE_NUMA_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <new>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "epoch.h"
+#include "locks.h"
+
+// NUMA placement
+// A NumaArena hands out memory from chunks bound to one node with mbind. The policy is
+// preferred, so a full node spills over instead of failing. Small blocks are carved by
+// power of 2 size class and recycled on per thread stripes, large ones are mapped alone.
+// Without kernel NUMA support, or off Linux, chunks are plain memory and the whole
+// machine is node 0.
+namespace lh {
+
+constexpr size_t max_numa_nodes = 64;   // one word of node mask
+
+size_t numa_node_count();       // online nodes, 1 without NUMA
+size_t numa_current_node();     // node of the cpu the caller is running on
+
+class NumaArena {
+public:
+    static NumaArena& on(size_t node);  // one per node, never freed. Wraps past the last node
+
+    NumaArena(const NumaArena&) = delete;
+    NumaArena& operator=(const NumaArena&) = delete;
+
+    void* allocate(size_t bytes, size_t align);     // align at most a page
+    void deallocate(void* p, size_t bytes, size_t align);
+
+    size_t node() const { return _node; }
+    bool bound() const { return _bound.load(); }    // every chunk so far took the binding
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static constexpr size_t page_bytes = 4096;
+    static constexpr size_t chunk_bytes = size_t{1} << 21;
+    static constexpr size_t min_class = 16;
+    static constexpr size_t num_classes = 13;   // 16 B .. 64 KiB
+    static constexpr size_t max_class = min_class << (num_classes - 1);
+    static constexpr size_t num_stripes = 16;
+
+    struct alignas(64) Stripe {
+        SpinLock lock;
+        std::array<FreeBlock*, num_classes> free{};
+        char* bump = nullptr;
+        char* bump_end = nullptr;
+    };
+
+    size_t _node;
+    std::atomic<bool> _bound{true};
+    std::array<Stripe, num_stripes> stripes;
+
+    explicit NumaArena(size_t node) : _node(node) {}
+
+    static size_t class_bytes(size_t bytes, size_t align) {
+        return std::max({std::bit_ceil(std::max<size_t>(bytes, 1)), align, min_class});
+    }
+    static size_t mapped_bytes(size_t bytes) { return (bytes + page_bytes - 1) / page_bytes * page_bytes; }
+
+    void* map(size_t bytes);    // page aligned, bound to the node when the kernel lets us
+    static void unmap(void* p, size_t bytes);
+    Stripe& local_stripe() { return stripes[EpochDomain::global().local().index % num_stripes]; }
+};
+
+// Allocates from the arena of one node, usable as a LinearHash Allocator
+template <typename T>
+struct NumaAllocator {
+    using value_type = T;
+    size_t node = 0;
+
+    explicit NumaAllocator(size_t node = 0) : node(node) {}
+    template <typename U>
+    NumaAllocator(const NumaAllocator<U>& other) : node(other.node) {}
+
+    T* allocate(size_t n);
+    void deallocate(T* p, size_t n) { NumaArena::on(node).deallocate(p, n * sizeof(T), alignof(T)); }
+
+    template <typename U>
+    bool operator==(const NumaAllocator<U>& other) const { return node == other.node; }
+};
+
+// IMPLEMENTATION===========================================
+inline size_t numa_node_count() {
+    // the online list reads like "0" or "0-1,3", the highest id bounds the count
+    static const size_t count = [] {
+        std::ifstream online("/sys/devices/system/node/online");
+        size_t highest = 0;
+        size_t value = 0;
+        for (char c = 0; online.get(c);) {
+            if (c >= '0' && c <= '9') {
+                value = value * 10 + static_cast<size_t>(c - '0');
+                highest = std::max(highest, value);
+            } else {
+                value = 0;
+            }
+        }
+        return std::min(highest + 1, max_numa_nodes);
+    }();
+    return count;
+}
+
+inline size_t numa_current_node() {
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 29)
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (getcpu(&cpu, &node) == 0) {
+        return std::min<size_t>(node, numa_node_count() - 1);
+    }
+#endif
+    return 0;
+}
+
+inline NumaArena& NumaArena::on(size_t node) {
+    static std::array<std::atomic<NumaArena*>, max_numa_nodes> arenas{};
+
+    node %= numa_node_count();
+    auto* arena = arenas[node].load();
+    if (arena == nullptr) {     // racing threads build one each, one wins
+        auto* fresh = new NumaArena(node);
+        if (arenas[node].compare_exchange_strong(arena, fresh)) {
+            arena = fresh;
+        } else {
+            delete fresh;
+        }
+    }
+    return *arena;
+}
+
+inline void* NumaArena::allocate(size_t bytes, size_t align) {
+    const auto size = class_bytes(bytes, align);
+    if (size > max_class) {
+        return map(mapped_bytes(bytes));
+    }
+
+    const auto index = static_cast<size_t>(std::countr_zero(size) - std::countr_zero(min_class));
+    auto& stripe = local_stripe();
+    std::lock_guard<SpinLock> lock(stripe.lock);
+    if (auto* block = stripe.free[index]) {
+        stripe.free[index] = block->next;
+        return block;
+    }
+
+    // blocks are aligned to their class, up to a page
+    const auto step = std::min(size, page_bytes);
+    auto at = (reinterpret_cast<uintptr_t>(stripe.bump) + step - 1) / step * step;
+    if (stripe.bump == nullptr || at + size > reinterpret_cast<uintptr_t>(stripe.bump_end)) {
+        stripe.bump = static_cast<char*>(map(chunk_bytes));     // the tail of the old chunk is dropped
+        stripe.bump_end = stripe.bump + chunk_bytes;
+        at = reinterpret_cast<uintptr_t>(stripe.bump);
+    }
+    stripe.bump = reinterpret_cast<char*>(at + size);
+    return reinterpret_cast<void*>(at);
+}
+
+inline void NumaArena::deallocate(void* p, size_t bytes, size_t align) {
+    const auto size = class_bytes(bytes, align);
+    if (size > max_class) {
+        unmap(p, mapped_bytes(bytes));
+        return;
+    }
+
+    // freed into the caller's stripe, the block stays on this node whoever reuses it
+    const auto index = static_cast<size_t>(std::countr_zero(size) - std::countr_zero(min_class));
+    auto& stripe = local_stripe();
+    std::lock_guard<SpinLock> lock(stripe.lock);
+    stripe.free[index] = new (p) FreeBlock{stripe.free[index]};
+}
+
+inline void* NumaArena::map(size_t bytes) {
+#if defined(__linux__)
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    auto bound = false;
+#if defined(SYS_mbind)
+    constexpr long mpol_preferred = 1;
+    const unsigned long mask = 1UL << _node;
+    // the kernel reads maxnode - 1 bits of mask
+    bound = syscall(SYS_mbind, p, bytes, mpol_preferred, &mask, sizeof(mask) * 8 + 1, 0UL) == 0;
+#endif
+    if (!bound) {
+        _bound.store(false);
+    }
+    return p;
+#else
+    _bound.store(false);
+    return ::operator new(bytes, std::align_val_t{page_bytes});
+#endif
+}
+
+inline void NumaArena::unmap(void* p, size_t bytes) {
+#if defined(__linux__)
+    munmap(p, bytes);
+#else
+    ::operator delete(p, bytes, std::align_val_t{page_bytes});
+#endif
+}
+
+template <typename T>
+T* NumaAllocator<T>::allocate(size_t n) {
+    if (n > SIZE_MAX / sizeof(T)) {
+        throw std::bad_array_new_length();
+    }
+    return static_cast<T*>(NumaArena::on(node).allocate(n * sizeof(T), alignof(T)));
+}
+
+} // namespace lh
+
+#endif //MVCC_LINEAR_HASHTABLE_NUMA_H
@@ -0,0 +1,91 @@
+#include <catch2/catch.hpp>
+#include "numa.h"
+#include "linear_hash.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("NUMA topology") {
+    REQUIRE(lh::numa_node_count() >= 1);
+    REQUIRE(lh::numa_node_count() <= lh::max_numa_nodes);
+    REQUIRE(lh::numa_current_node() < lh::numa_node_count());
+
+    // nodes past the last wrap onto a real one
+    REQUIRE(lh::NumaArena::on(lh::numa_node_count()).node() == 0);
+    REQUIRE(&lh::NumaArena::on(0) == &lh::NumaArena::on(0));
+}
+
+TEST_CASE("NUMA arena") {
+    auto& arena = lh::NumaArena::on(0);
+
+    SECTION("Blocks are aligned to their class and reused") {
+        auto* a = arena.allocate(24, 8);
+        REQUIRE(reinterpret_cast<uintptr_t>(a) % 32 == 0);
+        std::memset(a, 0xab, 24);
+        arena.deallocate(a, 24, 8);
+        REQUIRE(arena.allocate(32, 8) == a);     // same class, same thread
+        arena.deallocate(a, 32, 8);
+
+        auto* line = arena.allocate(8, 64);
+        REQUIRE(reinterpret_cast<uintptr_t>(line) % 64 == 0);
+        arena.deallocate(line, 8, 64);
+    }
+
+    SECTION("Large blocks are mapped alone") {
+        const size_t bytes = (size_t{1} << 20) + 100;
+        auto* big = static_cast<char*>(arena.allocate(bytes, 16));
+        REQUIRE(reinterpret_cast<uintptr_t>(big) % 4096 == 0);
+        big[0] = 1;
+        big[bytes - 1] = 2;
+        arena.deallocate(big, bytes, 16);
+    }
+
+    SECTION("Threads allocate and free concurrently") {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&arena, t]() {
+                std::vector<void*> blocks;
+                for (int i = 0; i < 2000; ++i) {
+                    const auto bytes = static_cast<size_t>(16 << (i % 6));
+                    auto* p = static_cast<unsigned char*>(arena.allocate(bytes, 16));
+                    std::memset(p, t, bytes);
+                    blocks.push_back(p);
+                }
+                for (size_t i = 0; i < blocks.size(); ++i) {
+                    arena.deallocate(blocks[i], static_cast<size_t>(16 << (i % 6)), 16);
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+    }
+}
+
+TEST_CASE("NUMA allocator") {
+    lh::NumaAllocator<int> ints(0);
+    lh::NumaAllocator<std::string> strings(ints);
+    REQUIRE(strings.node == 0);
+    REQUIRE(ints == strings);
+    REQUIRE_THROWS_AS(ints.allocate(SIZE_MAX / 2), std::bad_array_new_length);
+
+    SECTION("Places a whole table") {
+        using Alloc = lh::NumaAllocator<std::pair<const std::string, std::string>>;
+        LinearHash<std::string, std::string, std::hash<std::string>, std::equal_to<std::string>, Alloc>
+            map(2, 0.75, {}, {}, Alloc(0));
+        for (int i = 0; i < 2000; ++i) map.insert(std::to_string(i), std::string(40, 'v'));
+        for (int i = 0; i < 2000; i += 2) map.remove(std::to_string(i));
+
+        REQUIRE(map.get_num_elem() == 1000);
+        REQUIRE(map.get("1999").value() == std::string(40, 'v'));
+        REQUIRE(map.get_allocator().node == 0);
+    }
+
+    SECTION("Optimistic table with inline buckets") {
+        LinearHash<int, int, std::hash<int>, std::equal_to<int>, lh::NumaAllocator<std::pair<const int, int>>> map;
+        for (int i = 0; i < 5000; ++i) map.insert(i, -i);
+        REQUIRE(map.get(4999).value() == -4999);
+        REQUIRE(map.get_num_elem() == 5000);
+    }
+}
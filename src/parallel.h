@@ -0,0 +1,49 @@
+#ifndef MVCC_LINEAR_HASHTABLE_PARALLEL_H
+#define MVCC_LINEAR_HASHTABLE_PARALLEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// Fork join pool for the bulk operations
+// The caller is worker 0, the rest get a thread each. The first exception stops every
+// worker at its next check of the failed flag and is rethrown once all have joined.
+namespace lh::detail {
+
+// work(w, failed) runs once per worker and should return early once failed is set
+template <typename Work>
+void run_workers(size_t workers, const Work& work);
+
+// IMPLEMENTATION===========================================
+template <typename Work>
+void run_workers(size_t workers, const Work& work) {
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    auto guarded = [&](size_t w) {
+        try {
+            work(w, failed);
+        } catch (...) {
+            if (!failed.exchange(true)) {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t w = 1; w < workers; ++w) {
+        threads.emplace_back(guarded, w);
+    }
+    guarded(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace lh::detail
+
+#endif //MVCC_LINEAR_HASHTABLE_PARALLEL_H
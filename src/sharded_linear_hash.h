@@ -0,0 +1,367 @@
+#ifndef MVCC_LINEAR_HASHTABLE_SHARDED_LINEAR_HASH_H
+#define MVCC_LINEAR_HASHTABLE_SHARDED_LINEAR_HASH_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "counter.h"
+#include "linear_hash.h"
+#include "numa.h"
+#include "parallel.h"
+
+// Sharded front end
+// Keys are routed by the top bits of their mixed hash to one of N independent tables,
+// each with its own global lock, split pointer and count, so a split or a whole table
+// op stalls only the shard it runs in. The shards' own bucket choice uses the low bits,
+// so routing does not skew them.
+template <typename K, typename V, size_t N, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>,
+          typename Allocator = std::allocator<std::pair<const K, V>>, typename Lock = lh::SharedFutex>
+class ShardedLinearHash {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "shard count must be a power of 2");
+
+public:
+    using Shard = LinearHash<K, V, Hash, KeyEqual, Allocator, Lock>;
+    static constexpr size_t num_shards = N;
+
+private:
+    static constexpr int shard_bits = std::countr_zero(N);
+
+    Hash hash_fn;
+    std::array<std::unique_ptr<Shard>, N> shards;
+
+    // runs fn(shard index) for every shard, whole shards handed out to the workers.
+    // Rethrows the first exception once every worker has stopped
+    template <typename Fn>
+    void parallel_shards(size_t nthreads, const Fn& fn) const;
+
+public:
+    class Iterator {    // shard by shard, same guarantees as LinearHash::Iterator
+    private:
+        const ShardedLinearHash* _hm;
+        size_t _shard;
+        typename Shard::Iterator _it;
+
+        void go2data() {    //helper to skip empty shards
+            while (_it == _hm->shard(_shard).end() && _shard + 1 < N) {
+                ++_shard;
+                _it = _hm->shard(_shard).begin();
+            }
+        }
+
+    public:
+        using value_type = typename Shard::Iterator::value_type;
+        using pointer = typename Shard::Iterator::pointer;
+        using reference = typename Shard::Iterator::reference;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        Iterator(const ShardedLinearHash* hm, size_t shard, typename Shard::Iterator it)
+            : _hm(hm), _shard(shard), _it(it) {
+            go2data();
+        }
+
+        reference operator*() const { return *_it; }
+        pointer operator->() const { return _it.operator->(); }
+
+        Iterator& operator++() {
+            ++_it;
+            go2data();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        friend bool operator==(const Iterator& a, const Iterator& b) {
+            return a._shard == b._shard && a._it == b._it;
+        }
+        friend bool operator!=(const Iterator& a, const Iterator& b) { return !(a == b); }
+    };
+
+    // size and load_factor are per shard
+    explicit ShardedLinearHash(size_t size = 2, double load_factor = 0.75, const Hash& hash = Hash(),
+                               const KeyEqual& equal = KeyEqual(), const Allocator& allocator = Allocator());
+    // one allocator per shard, to place each shard's memory apart
+    ShardedLinearHash(size_t size, double load_factor, const Hash& hash, const KeyEqual& equal,
+                      const std::array<Allocator, N>& allocators);
+
+    ShardedLinearHash(const ShardedLinearHash&) = delete;
+    ShardedLinearHash& operator=(const ShardedLinearHash&) = delete;
+
+    size_t shard_of(const K& key) const;
+    Shard& shard(size_t i) { return *shards[i]; }
+    const Shard& shard(size_t i) const { return *shards[i]; }
+
+    void insert(const K& key, const V& val) { shard(shard_of(key)).insert(key, val); }
+    std::optional<V> get(const K& key) const { return shard(shard_of(key)).get(key); }
+    bool in(const K& key) const { return shard(shard_of(key)).in(key); }
+    bool remove(const K& key) { return shard(shard_of(key)).remove(key); }
+
+    // Bulk API: items are partitioned by shard, then every shard takes its part in one
+    // batch, the shards in parallel. nthreads 0 == hardware concurrency, capped at N.
+    // Later duplicates win, as for LinearHash::insert_batch
+    void insert_batch(std::span<const std::pair<K, V>> items, size_t nthreads = 0);
+    void get_many(std::span<const K> keys, std::span<std::optional<V>> results, size_t nthreads = 0) const;
+
+    // fn(key, value) runs on several threads at once, one shard per worker at a time
+    template <typename Fn>
+    void parallel_for_each(Fn fn, size_t nthreads = 0) const;
+
+    Hash hash_function() const { return hash_fn; }
+    KeyEqual key_eq() const { return shards[0]->key_eq(); }
+    Allocator get_allocator() const { return shards[0]->get_allocator(); }
+
+    size_t get_table_size() const;  // buckets over every shard
+    size_t get_num_elem() const;
+
+    Iterator begin() const { return Iterator(this, 0, shard(0).begin()); }
+    Iterator end() const { return Iterator(this, N - 1, shard(N - 1).end()); }
+};
+
+// NUMA placed shards
+// Shard i keeps its buckets and entries blocks on node i % numa_node_count(), through
+// an lh::NumaAllocator. Single key operations count, per node of the calling thread,
+// whether they landed on a shard of that node. Bulk operations are not counted
+template <typename K, typename V, size_t N, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>,
+          typename Lock = lh::SharedFutex>
+class NumaShardedLinearHash
+    : private ShardedLinearHash<K, V, N, Hash, KeyEqual, lh::NumaAllocator<std::pair<const K, V>>, Lock> {
+    using Base = ShardedLinearHash<K, V, N, Hash, KeyEqual, lh::NumaAllocator<std::pair<const K, V>>, Lock>;
+
+    struct Counters {
+        lh::StripedCounter local;
+        lh::StripedCounter remote;
+    };
+    static constexpr size_t stats_slack = 64;   // per stripe, see lh::StripedCounter
+
+    std::unique_ptr<Counters[]> counters;   // one per node
+
+    static std::array<lh::NumaAllocator<std::pair<const K, V>>, N> placement();
+    size_t record(size_t shard) const;      // counts the access, passes the shard through
+
+public:
+    using typename Base::Shard;
+    using typename Base::Iterator;
+    using Base::num_shards;
+
+    struct NodeStats {
+        size_t local = 0;
+        size_t remote = 0;
+        double local_ratio() const {
+            const auto total = local + remote;
+            return total == 0 ? 1.0 : static_cast<double>(local) / static_cast<double>(total);
+        }
+    };
+
+    explicit NumaShardedLinearHash(size_t size = 2, double load_factor = 0.75, const Hash& hash = Hash(),
+                                   const KeyEqual& equal = KeyEqual());
+
+    using Base::shard_of;
+    using Base::shard;
+    size_t node_of_shard(size_t i) const { return shard(i).get_allocator().node; }
+    size_t node_of(const K& key) const { return node_of_shard(shard_of(key)); }
+    bool is_local(const K& key) const { return node_of(key) == lh::numa_current_node(); }
+
+    // For callers free to choose their keys (ids, slots): draws from next() until a key
+    // routes to a shard on the caller's node, giving up with the last one after max_tries
+    template <typename NextKey>
+    K local_key(NextKey next, size_t max_tries = 4 * N) const;
+
+    void insert(const K& key, const V& val) { shard(record(shard_of(key))).insert(key, val); }
+    std::optional<V> get(const K& key) const { return shard(record(shard_of(key))).get(key); }
+    bool in(const K& key) const { return shard(record(shard_of(key))).in(key); }
+    bool remove(const K& key) { return shard(record(shard_of(key))).remove(key); }
+
+    using Base::insert_batch;
+    using Base::get_many;
+    using Base::parallel_for_each;
+
+    using Base::hash_function;
+    using Base::key_eq;
+    using Base::get_table_size;
+    using Base::get_num_elem;
+    using Base::begin;
+    using Base::end;
+
+    NodeStats node_stats(size_t node) const;   // accesses made from threads on node
+};
+
+// IMPLEMENTATION===========================================
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+ShardedLinearHash<K, V, N, Hash, KeyEqual, Allocator, Lock>::ShardedLinearHash(size_t size, double load_factor,
+                                                                              const Hash& hash, const KeyEqual& equal,
+                                                                              const Allocator& allocator)
+    : hash_fn(hash) {
+    for (auto& s : shards) {
+        s = std::make_unique<Shard>(size, load_factor, hash, equal, allocator);
+    }
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+ShardedLinearHash<K, V, N, Hash, KeyEqual, Allocator, Lock>::ShardedLinearHash(size_t size, double load_factor,
+                                                                              const Hash& hash, const KeyEqual& equal,
+                                                                              const std::array<Allocator, N>& allocators)
+    : hash_fn(hash) {
+    for (size_t i = 0; i < N; ++i) {
+        shards[i] = std::make_unique<Shard>(size, load_factor, hash, equal, allocators[i]);
+    }
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+size_t ShardedLinearHash<K, V, N, Hash, KeyEqual, Allocator, Lock>::shard_of(const K& key) const {
+    if constexpr (N == 1) {
+        return 0;
+    } else {
+        // the multiply folds every hash bit into the top ones, identity hashes included
+        const auto mixed = static_cast<uint64_t>(hash_fn(key)) * 0x9e3779b97f4a7c15ULL;
+        return static_cast<size_t>(mixed >> (64 - shard_bits));
+    }
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+template <typename Fn>
+void ShardedLinearHash<K, V, N, Hash, KeyEqual, Allocator, Lock>::parallel_shards(size_t nthreads, const Fn& fn) const {
+    if (nthreads == 0) {
+        nthreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    std::atomic<size_t> next{0};
+    lh::detail::run_workers(std::min(nthreads, N), [&](size_t, const std::atomic<bool>& failed) {
+        for (auto i = next.fetch_add(1); i < N && !failed.load(); i = next.fetch_add(1)) {
+            fn(i);
+        }
+    });
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void ShardedLinearHash<K, V, N, Hash, KeyEqual, Allocator, Lock>::insert_batch(std::span<const std::pair<K, V>> items,
+                                                                              size_t nthreads) {
+    std::array<std::vector<std::pair<K, V>>, N> parts;
+    for (const auto& item : items) {
+        parts[shard_of(item.first)].push_back(item);
+    }
+
+    parallel_shards(nthreads, [&](size_t i) {
+        if (!parts[i].empty()) {
+            shards[i]->insert_batch_move(parts[i]);
+        }
+    });
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+void ShardedLinearHash<K, V, N, Hash, KeyEqual, Allocator, Lock>::get_many(std::span<const K> keys,
+                                                                          std::span<std::optional<V>> results,
+                                                                          size_t nthreads) const {
+    if (keys.size() != results.size()) {
+        throw std::invalid_argument("get_many: keys and results differ in size");
+    }
+
+    // gather each shard's keys, look them up in one get_many, scatter back
+    std::array<std::vector<size_t>, N> positions;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        positions[shard_of(keys[i])].push_back(i);
+    }
+
+    parallel_shards(nthreads, [&](size_t s) {
+        const auto& at = positions[s];
+        if (at.empty()) {
+            return;
+        }
+
+        std::vector<K> part;
+        part.reserve(at.size());
+        for (const auto i : at) {
+            part.push_back(keys[i]);
+        }
+        std::vector<std::optional<V>> found(at.size());
+        shards[s]->get_many(part, found);
+
+        for (size_t j = 0; j < at.size(); ++j) {
+            results[at[j]] = std::move(found[j]);
+        }
+    });
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+template <typename Fn>
+void ShardedLinearHash<K, V, N, Hash, KeyEqual, Allocator, Lock>::parallel_for_each(Fn fn, size_t nthreads) const {
+    parallel_shards(nthreads, [&](size_t i) {
+        shards[i]->parallel_for_each(fn, 1);
+    });
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+size_t ShardedLinearHash<K, V, N, Hash, KeyEqual, Allocator, Lock>::get_table_size() const {
+    size_t total = 0;
+    for (const auto& s : shards) {
+        total += s->get_table_size();
+    }
+    return total;
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Allocator, typename Lock>
+size_t ShardedLinearHash<K, V, N, Hash, KeyEqual, Allocator, Lock>::get_num_elem() const {
+    size_t total = 0;
+    for (const auto& s : shards) {
+        total += s->get_num_elem();
+    }
+    return total;
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Lock>
+NumaShardedLinearHash<K, V, N, Hash, KeyEqual, Lock>::NumaShardedLinearHash(size_t size, double load_factor,
+                                                                           const Hash& hash, const KeyEqual& equal)
+    : Base(size, load_factor, hash, equal, placement()), counters(new Counters[lh::numa_node_count()]) {}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Lock>
+auto NumaShardedLinearHash<K, V, N, Hash, KeyEqual, Lock>::placement()
+    -> std::array<lh::NumaAllocator<std::pair<const K, V>>, N> {
+    std::array<lh::NumaAllocator<std::pair<const K, V>>, N> allocators;
+    for (size_t i = 0; i < N; ++i) {
+        allocators[i].node = i % lh::numa_node_count();
+    }
+    return allocators;
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Lock>
+size_t NumaShardedLinearHash<K, V, N, Hash, KeyEqual, Lock>::record(size_t shard) const {
+    const auto here = lh::numa_current_node();
+    auto& counter = node_of_shard(shard) == here ? counters[here].local : counters[here].remote;
+    counter.add(1, stats_slack);
+    return shard;
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Lock>
+template <typename NextKey>
+K NumaShardedLinearHash<K, V, N, Hash, KeyEqual, Lock>::local_key(NextKey next, size_t max_tries) const {
+    const auto here = lh::numa_current_node();
+    K key = next();
+    for (size_t tries = 1; tries < max_tries && node_of(key) != here; ++tries) {
+        key = next();
+    }
+    return key;
+}
+
+template <typename K, typename V, size_t N, typename Hash, typename KeyEqual, typename Lock>
+auto NumaShardedLinearHash<K, V, N, Hash, KeyEqual, Lock>::node_stats(size_t node) const -> NodeStats {
+    if (node >= lh::numa_node_count()) {
+        return NodeStats{};
+    }
+    return NodeStats{counters[node].local.exact(), counters[node].remote.exact()};
+}
+
+#endif //MVCC_LINEAR_HASHTABLE_SHARDED_LINEAR_HASH_H
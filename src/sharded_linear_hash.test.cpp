@@ -0,0 +1,209 @@
+#include <catch2/catch.hpp>
+#include "sharded_linear_hash.h"
+
+#include <atomic>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Sharded basic operations") {
+    ShardedLinearHash<int, int, 4> map(2, 0.75);
+
+    SECTION("Initialization") {
+        REQUIRE(map.get_num_elem() == 0);
+        REQUIRE(map.get_table_size() == 4 * 2);
+        REQUIRE(map.begin() == map.end());
+    }
+
+    SECTION("Insert, get, overwrite, remove") {
+        map.insert(1, 100);
+        map.insert(2, 200);
+        map.insert(1, 999);
+
+        REQUIRE(map.get_num_elem() == 2);
+        REQUIRE(map.get(1).value() == 999);
+        REQUIRE(map.get(2).value() == 200);
+        REQUIRE_FALSE(map.get(3).has_value());
+
+        REQUIRE(map.remove(1));
+        REQUIRE_FALSE(map.remove(1));
+        REQUIRE_FALSE(map.in(1));
+        REQUIRE(map.get_num_elem() == 1);
+    }
+
+    SECTION("Keys land in their shard") {
+        for (int i = 0; i < 1000; ++i) {
+            map.insert(i, i);
+        }
+        size_t total = 0;
+        for (size_t s = 0; s < map.num_shards; ++s) {
+            // small identity hashed keys still spread over every shard
+            REQUIRE(map.shard(s).get_num_elem() > 100);
+            total += map.shard(s).get_num_elem();
+        }
+        REQUIRE(total == 1000);
+        REQUIRE(map.shard(map.shard_of(42)).in(42));
+        REQUIRE(map.get_table_size() > 4 * 2);
+    }
+}
+
+TEST_CASE("Sharded single shard") {
+    ShardedLinearHash<std::string, int, 1> map;
+    map.insert("a", 1);
+    REQUIRE(map.shard_of("a") == 0);
+    REQUIRE(map.get("a").value() == 1);
+}
+
+TEST_CASE("Sharded iterator") {
+    ShardedLinearHash<std::string, int, 8> map(2, 0.75);
+    for (int i = 0; i < 300; ++i) {
+        map.insert("key" + std::to_string(i), i);
+    }
+
+    std::set<std::string> seen;
+    int sum = 0;
+    for (const auto& entry : map) {
+        REQUIRE(seen.insert(entry.key).second);
+        sum += entry.value;
+    }
+    REQUIRE(seen.size() == 300);
+    REQUIRE(sum == 299 * 300 / 2);
+
+    // a lone key in the last shard is still reached
+    ShardedLinearHash<int, int, 8> sparse;
+    int key = 0;
+    while (sparse.shard_of(key) != 7) {
+        ++key;
+    }
+    sparse.insert(key, 1);
+    REQUIRE(std::distance(sparse.begin(), sparse.end()) == 1);
+    REQUIRE(sparse.begin()->key == key);
+}
+
+TEST_CASE("Sharded bulk operations") {
+    ShardedLinearHash<int, int, 4> map(2, 0.75);
+
+    std::vector<std::pair<int, int>> items;
+    for (int i = 0; i < 5000; ++i) {
+        items.emplace_back(i, i * 3);
+    }
+    items.emplace_back(7, -1);  // later duplicate wins
+    map.insert_batch(items, 4);
+    REQUIRE(map.get_num_elem() == 5000);
+
+    std::vector<int> keys;
+    for (int i = 0; i < 6000; i += 3) {
+        keys.push_back(i);
+    }
+    keys.push_back(7);
+    std::vector<std::optional<int>> results(keys.size());
+    map.get_many(keys, results, 4);
+
+    for (size_t i = 0; i + 1 < keys.size(); ++i) {
+        if (keys[i] < 5000) {
+            REQUIRE(results[i] == keys[i] * 3);
+        } else {
+            REQUIRE_FALSE(results[i].has_value());
+        }
+    }
+    REQUIRE(results.back() == -1);
+
+    std::vector<std::optional<int>> too_few(keys.size() - 1);
+    REQUIRE_THROWS_AS(map.get_many(keys, too_few, 4), std::invalid_argument);
+
+    std::atomic<long long> sum{0};
+    std::atomic<int> count{0};
+    map.parallel_for_each([&](int key, int value) {
+        sum += value;
+        ++count;
+        (void)key;
+    }, 4);
+    REQUIRE(count == 5000);
+    REQUIRE(sum == 3LL * 4999 * 5000 / 2 - 21 - 1);
+
+    SECTION("Exceptions propagate") {
+        REQUIRE_THROWS_AS(map.parallel_for_each([](int, int) { throw std::runtime_error("stop"); }, 4),
+                          std::runtime_error);
+    }
+}
+
+TEST_CASE("Sharded concurrency") {
+    const int NUM_THREADS = 8;
+    const int ITEMS_PER_THREAD = 5000;
+    ShardedLinearHash<int, int, 4> map(2, 0.75);
+
+    std::atomic<int> read_errors{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NUM_THREADS; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < ITEMS_PER_THREAD; ++i) {
+                const int key = (t * 1000000) + i;
+                map.insert(key, i);
+                if (map.get(key) != i) {
+                    ++read_errors;
+                }
+            }
+            for (int i = 0; i < ITEMS_PER_THREAD; i += 2) {
+                map.remove((t * 1000000) + i);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    REQUIRE(read_errors == 0);
+    REQUIRE(map.get_num_elem() == NUM_THREADS * ITEMS_PER_THREAD / 2);
+}
+
+TEST_CASE("NUMA sharded") {
+    NumaShardedLinearHash<int, int, 4> map(2, 0.75);
+
+    SECTION("Shards are placed round robin over the nodes") {
+        for (size_t s = 0; s < map.num_shards; ++s) {
+            REQUIRE(map.node_of_shard(s) == s % lh::numa_node_count());
+        }
+    }
+
+    SECTION("Operations and iteration") {
+        for (int i = 0; i < 1000; ++i) {
+            map.insert(i, i);
+        }
+        REQUIRE(map.remove(0));
+        REQUIRE(map.get(999).value() == 999);
+        REQUIRE_FALSE(map.in(0));
+        REQUIRE(map.get_num_elem() == 999);
+        REQUIRE(std::distance(map.begin(), map.end()) == 999);
+    }
+
+    SECTION("Every single key access is counted once") {
+        for (int i = 0; i < 500; ++i) {
+            map.insert(i, i);
+            (void)map.get(i);
+        }
+
+        size_t total = 0;
+        for (size_t node = 0; node < lh::numa_node_count(); ++node) {
+            const auto stats = map.node_stats(node);
+            total += stats.local + stats.remote;
+            REQUIRE(stats.local_ratio() >= 0.0);
+            REQUIRE(stats.local_ratio() <= 1.0);
+        }
+        REQUIRE(total == 1000);
+        if (lh::numa_node_count() == 1) {
+            REQUIRE(map.node_stats(0).remote == 0);
+            REQUIRE(map.node_stats(0).local_ratio() == 1.0);
+        }
+    }
+
+    SECTION("Local keys") {
+        int next = 0;
+        const auto key = map.local_key([&] { return next++; });
+        REQUIRE(next <= 4 * 4);
+        if (lh::numa_node_count() == 1) {   // elsewhere the caller may migrate in between
+            REQUIRE(map.is_local(key));
+            REQUIRE(next == 1);
+        }
+        map.insert(key, 1);
+        REQUIRE(map.get(key).value() == 1);
+    }
+}